@@ -1,40 +1,155 @@
 #include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
 #include "ButtonInput.h"
+#include "Power.h"
+#include "Metrics.h"
 
 const int RIGHT_BTN_PIN = 41;
 const int LEFT_BTN_PIN = 42;
 const int SLCT_BTN_PIN = 40;
 
-// Internal state for edge detection
-static int lastRightState = LOW;
-static int lastLeftState = LOW;
-static int lastSelectState = LOW;
+static const uint32_t DEBOUNCE_US = 20000;   // Edges closer than this are contact bounce
+static const uint32_t LONG_PRESS_MS = 800;
+
+// Per-button state, written only by the edge ISR and its settle timer;
+// the consumer side only reads it
+struct ButtonChannel {
+  int pin;
+  volatile int level;          // Last debounced level
+  volatile uint32_t lastEdgeUs;
+  volatile uint32_t pressedUs; // Time of the last accepted press
+  volatile bool held;
+  volatile bool settling;      // An edge fell inside the debounce window; the pin is read again after it
+  esp_timer_handle_t settleTimer;
+  bool longReported;           // Owned by the consumer side
+};
+
+static ButtonChannel buttons[] = {
+  {RIGHT_BTN_PIN, LOW, 0, 0, false, false, nullptr, false},
+  {LEFT_BTN_PIN, LOW, 0, 0, false, false, nullptr, false},
+  {SLCT_BTN_PIN, LOW, 0, 0, false, false, nullptr, false},
+};
+// Serialises the edge ISRs with the settle timers, the two writers of ButtonChannel
+static portMUX_TYPE buttonMux = portMUX_INITIALIZER_UNLOCKED;
+static const int buttonCount = sizeof(buttons) / sizeof(buttons[0]);
+
+// Single-producer (ISRs and settle timers) / single-consumer (loop) event ring.
+// Producers only push while holding buttonMux, so they act as one producer.
+static const uint8_t EVENT_QUEUE_SIZE = 16; // Power of two
+static ButtonEvent eventQueue[EVENT_QUEUE_SIZE];
+static std::atomic<uint8_t> eventHead(0); // Next slot to write (ISR)
+static std::atomic<uint8_t> eventTail(0); // Next slot to read (loop)
+
+static void IRAM_ATTR pushEvent(uint8_t pin, ButtonEventType type, uint32_t timeUs, bool fromISR) {
+  uint8_t head = eventHead.load(std::memory_order_relaxed);
+  uint8_t next = (head + 1) & (EVENT_QUEUE_SIZE - 1);
+  if (next == eventTail.load(std::memory_order_acquire)) {
+    metricInc(METRIC_BUTTON_DROPS);
+    return;
+  }
+  eventQueue[head] = {pin, type, timeUs};
+  eventHead.store(next, std::memory_order_release);
+  if (fromISR) powerWakeFromISR();
+  else powerWake();
+}
+
+// Called with buttonMux held
+static void IRAM_ATTR applyLevel(ButtonChannel& b, int level, uint32_t now, bool fromISR) {
+  if (level == b.level) return;
+  b.lastEdgeUs = now;
+  b.level = level;
+  if (level == HIGH) {
+    b.pressedUs = now;
+    b.held = true;
+    pushEvent(b.pin, BUTTON_PRESS, now, fromISR);
+  } else {
+    b.held = false;
+    pushEvent(b.pin, BUTTON_RELEASE, now, fromISR);
+  }
+}
+
+static void IRAM_ATTR handleEdge(ButtonChannel& b) {
+  uint32_t now = micros();
+  portENTER_CRITICAL_ISR(&buttonMux);
+  if (now - b.lastEdgeUs < DEBOUNCE_US) {
+    // Contact bounce, or a real edge hiding in it: look again once it has settled.
+    // A timer already armed by an earlier bounce does the same job.
+    b.settling = true;
+    esp_timer_start_once(b.settleTimer, DEBOUNCE_US);
+  } else {
+    applyLevel(b, digitalRead(b.pin), now, true);
+  }
+  portEXIT_CRITICAL_ISR(&buttonMux);
+}
+
+// Settle timer: the last edge inside the debounce window may have changed the level
+static void settleCallback(void* arg) {
+  ButtonChannel& b = *(ButtonChannel*)arg;
+  portENTER_CRITICAL(&buttonMux);
+  b.settling = false;
+  applyLevel(b, digitalRead(b.pin), micros(), false);
+  portEXIT_CRITICAL(&buttonMux);
+}
+
+static void IRAM_ATTR rightISR() { handleEdge(buttons[0]); }
+static void IRAM_ATTR leftISR() { handleEdge(buttons[1]); }
+static void IRAM_ATTR selectISR() { handleEdge(buttons[2]); }
 
 void buttonSetup(){
-  pinMode(RIGHT_BTN_PIN, INPUT);
-  pinMode(LEFT_BTN_PIN, INPUT);
-  pinMode(SLCT_BTN_PIN, INPUT);
-  lastRightState = digitalRead(RIGHT_BTN_PIN);
-  lastLeftState = digitalRead(LEFT_BTN_PIN);
-  lastSelectState = digitalRead(SLCT_BTN_PIN);
-}
-
-// Returns true only on the rising edge (LOW -> HIGH)
-bool isButtonClicked(int pin) {
-  int currentState = digitalRead(pin);
-  bool clicked = false;
-  if (pin == RIGHT_BTN_PIN) {
-    clicked = (lastRightState == LOW && currentState == HIGH);
-    lastRightState = currentState;
-  } else if (pin == LEFT_BTN_PIN) {
-    clicked = (lastLeftState == LOW && currentState == HIGH);
-    lastLeftState = currentState;
-  } else if (pin == SLCT_BTN_PIN) {
-    clicked = (lastSelectState == LOW && currentState == HIGH);
-    lastSelectState = currentState;
+  void (*isrs[])() = {rightISR, leftISR, selectISR};
+  for (int i = 0; i < buttonCount; ++i) {
+    pinMode(buttons[i].pin, INPUT);
+    buttons[i].level = digitalRead(buttons[i].pin);
+    buttons[i].held = false;
+    buttons[i].longReported = false;
+    esp_timer_create_args_t args = {};
+    args.callback = settleCallback;
+    args.arg = &buttons[i];
+    args.name = "button_settle";
+    esp_timer_create(&args, &buttons[i].settleTimer);
+    attachInterrupt(digitalPinToInterrupt(buttons[i].pin), isrs[i], CHANGE);
   }
-  return clicked;
 }
 
+// Long presses are derived on the consumer side so the ISRs stay the only producer
+static bool checkLongPress(ButtonEvent& ev) {
+  uint32_t now = micros();
+  for (int i = 0; i < buttonCount; ++i) {
+    ButtonChannel& b = buttons[i];
+    if (!b.held) {
+      b.longReported = false;
+      continue;
+    }
+    if (b.longReported || b.settling || now - b.pressedUs < LONG_PRESS_MS * 1000) continue;
+    b.longReported = true;
+    ev = {(uint8_t)b.pin, BUTTON_LONG_PRESS, b.pressedUs + LONG_PRESS_MS * 1000};
+    return true;
+  }
+  return false;
+}
 
+bool buttonGetEvent(ButtonEvent& ev) {
+  uint8_t tail = eventTail.load(std::memory_order_relaxed);
+  if (tail != eventHead.load(std::memory_order_acquire)) {
+    ev = eventQueue[tail];
+    eventTail.store((tail + 1) & (EVENT_QUEUE_SIZE - 1), std::memory_order_release);
+    return true;
+  }
+  return checkLongPress(ev);
+}
 
+uint32_t buttonMsUntilLongPress() {
+  uint32_t wait = 0xFFFFFFFFUL;
+  uint32_t now = micros();
+  for (int i = 0; i < buttonCount; ++i) {
+    const ButtonChannel& b = buttons[i];
+    // Light sleep holds the settle timer back, so wake for it
+    if (b.settling) wait = min(wait, DEBOUNCE_US / 1000 + 1);
+    if (!b.held || b.longReported) continue;
+    uint32_t heldUs = now - b.pressedUs;
+    uint32_t leftMs = heldUs >= LONG_PRESS_MS * 1000 ? 0 : (LONG_PRESS_MS * 1000 - heldUs + 999) / 1000;
+    if (leftMs < wait) wait = leftMs;
+  }
+  return wait;
+}
@@ -1,9 +1,26 @@
 #pragma once
 
+#include <stdint.h>
+
 extern const int RIGHT_BTN_PIN;
 extern const int LEFT_BTN_PIN;
 extern const int SLCT_BTN_PIN;
 
-void buttonSetup();
-bool isButtonClicked(int pin);
+enum ButtonEventType : uint8_t {
+  BUTTON_PRESS,      // Debounced rising edge (LOW -> HIGH)
+  BUTTON_RELEASE,    // Debounced falling edge (HIGH -> LOW)
+  BUTTON_LONG_PRESS  // Button held for LONG_PRESS_MS, reported once per press
+};
 
+struct ButtonEvent {
+  uint8_t pin;
+  ButtonEventType type;
+  uint32_t timeUs; // micros() at the edge that caused the event
+};
+
+void buttonSetup();
+// Pops the next button event, returns false when nothing is pending
+bool buttonGetEvent(ButtonEvent& ev);
+// Milliseconds until a held button turns into a long press or a bounced edge
+// settles, 0xFFFFFFFF if none
+uint32_t buttonMsUntilLongPress();
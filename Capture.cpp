@@ -0,0 +1,110 @@
+#include "Capture.h"
+#include "Device.h"
+
+#ifdef USE_FRAME_CAPTURE
+
+struct CaptureSlot {
+    uint64_t timeUs;
+    CapturePseudoHeader header;
+    uint8_t len;
+    uint8_t data[CAPTURE_MAX_FRAME];
+};
+
+static CaptureSlot slots[CAPTURE_SLOTS];
+static uint32_t captured = 0; // Frames recorded since the last clear
+static bool paused = false;   // Set while a dump walks the ring
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+void captureFrame(CaptureDirection direction, const uint8_t* mac, int8_t rssi, const uint8_t* data, int len) {
+    if (len < 0) return;
+    if (len > CAPTURE_MAX_FRAME) len = CAPTURE_MAX_FRAME;
+    uint64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&captureMux);
+    if (!paused) {
+        CaptureSlot& s = slots[captured % CAPTURE_SLOTS];
+        s.timeUs = now;
+        s.header.direction = direction;
+        s.header.rssi = rssi;
+        memcpy(s.header.mac, mac, 6);
+        s.len = (uint8_t)len;
+        memcpy(s.data, data, len);
+        captured++;
+    }
+    portEXIT_CRITICAL(&captureMux);
+}
+
+static void writeRecord(Print& out, uint64_t timeUs, const CapturePseudoHeader& header,
+                        const uint8_t* data, uint32_t len) {
+    PcapRecordHeader rec;
+    rec.tsSec = (uint32_t)(timeUs / 1000000ULL);
+    rec.tsUsec = (uint32_t)(timeUs % 1000000ULL);
+    rec.inclLen = sizeof(header) + len;
+    rec.origLen = rec.inclLen;
+    out.write((const uint8_t*)&rec, sizeof(rec));
+    out.write((const uint8_t*)&header, sizeof(header));
+    out.write(data, len);
+}
+
+// Own identity and peers, so a replay starts from the same state
+static void writeInfo(Print& out) {
+    const std::vector<Device::PeerInfo>& peers = device.getPeerList();
+    uint8_t buf[sizeof(CaptureInfo) + 16 * sizeof(CapturePeer)];
+    CaptureInfo info;
+    info.userState = device.getUserState();
+    info.peerCount = 0;
+    size_t len = sizeof(info);
+    for (size_t i = 1; i < peers.size() && len + sizeof(CapturePeer) <= sizeof(buf); ++i) {
+        CapturePeer p;
+        memcpy(p.mac, peers[i].mac, 6);
+        memcpy(p.initials, peers[i].initials, sizeof(p.initials));
+        memcpy(buf + len, &p, sizeof(p));
+        len += sizeof(p);
+        info.peerCount++;
+    }
+    memcpy(buf, &info, sizeof(info));
+    CapturePseudoHeader header;
+    header.direction = CAPTURE_INFO;
+    header.rssi = 0;
+    memcpy(header.mac, device.getMACAddress(), 6);
+    writeRecord(out, esp_timer_get_time(), header, buf, len);
+}
+
+void captureDump(Print& out) {
+    portENTER_CRITICAL(&captureMux);
+    paused = true;
+    portEXIT_CRITICAL(&captureMux);
+
+    PcapFileHeader file;
+    file.magic = CAPTURE_PCAP_MAGIC;
+    file.versionMajor = 2;
+    file.versionMinor = 4;
+    file.thisZone = 0;
+    file.sigFigs = 0;
+    file.snapLen = sizeof(CapturePseudoHeader) + CAPTURE_MAX_FRAME;
+    file.linkType = CAPTURE_PCAP_LINKTYPE;
+    out.write((const uint8_t*)&file, sizeof(file));
+    writeInfo(out);
+    uint32_t first = captured > CAPTURE_SLOTS ? captured - CAPTURE_SLOTS : 0;
+    for (uint32_t n = first; n < captured; ++n) {
+        const CaptureSlot& s = slots[n % CAPTURE_SLOTS];
+        writeRecord(out, s.timeUs, s.header, s.data, s.len);
+    }
+
+    portENTER_CRITICAL(&captureMux);
+    paused = false;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+void captureClear() {
+    portENTER_CRITICAL(&captureMux);
+    captured = 0;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+#else
+
+void captureFrame(CaptureDirection, const uint8_t*, int8_t, const uint8_t*, int) {}
+void captureDump(Print& out) { out.println("capture disabled, build with USE_FRAME_CAPTURE"); }
+void captureClear() {}
+
+#endif // USE_FRAME_CAPTURE
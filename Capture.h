@@ -0,0 +1,22 @@
+// Capture.h
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "CaptureFormat.h"
+
+// Uncomment the next line to record raw radio frames for the "capture" console
+// command. Costs CAPTURE_SLOTS * ~270 bytes of RAM.
+//#define USE_FRAME_CAPTURE
+
+#define CAPTURE_SLOTS 32 // Most recent frames kept, oldest overwritten
+
+// Record one frame; safe from the radio callbacks
+void captureFrame(CaptureDirection direction, const uint8_t* mac, int8_t rssi, const uint8_t* data, int len);
+// Write the ring as a pcap file, oldest frame first. Blocks the loop while
+// the UART drains (about a second for a full ring at 115200 baud).
+void captureDump(Print& out);
+void captureClear();
+
+#endif // CAPTURE_H
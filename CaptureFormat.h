@@ -0,0 +1,57 @@
+// CaptureFormat.h
+// Frame capture export format, shared by the firmware (Capture.h) and the
+// host replay tool (tools/replay.cpp). The export is a standard pcap file
+// with a user link type, so it also opens in Wireshark.
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+#define CAPTURE_PCAP_MAGIC 0xA1B2C3D4UL // Microsecond timestamps
+#define CAPTURE_PCAP_LINKTYPE 147       // LINKTYPE_USER0
+#define CAPTURE_MAX_FRAME 250           // ESP_NOW_MAX_DATA_LEN
+
+enum CaptureDirection : uint8_t {
+    CAPTURE_RX,   // Frame received, mac is the sender
+    CAPTURE_TX,   // Frame handed to the driver, mac is the destination
+    CAPTURE_INFO  // Capturing unit: mac is its own address, data is a CaptureInfo
+};
+
+struct __attribute__((packed)) PcapFileHeader {
+    uint32_t magic;
+    uint16_t versionMajor; // 2
+    uint16_t versionMinor; // 4
+    int32_t thisZone;
+    uint32_t sigFigs;
+    uint32_t snapLen;
+    uint32_t linkType;
+};
+
+struct __attribute__((packed)) PcapRecordHeader {
+    uint32_t tsSec;
+    uint32_t tsUsec;
+    uint32_t inclLen; // sizeof(CapturePseudoHeader) + frame bytes
+    uint32_t origLen;
+};
+
+// Precedes the raw ESP-NOW payload in every pcap record
+struct __attribute__((packed)) CapturePseudoHeader {
+    uint8_t direction; // CaptureDirection
+    int8_t rssi;       // dBm, 0 for transmitted frames
+    uint8_t mac[6];
+};
+
+// Payload of the CAPTURE_INFO record written at the start of an export, so a
+// replay starts from the same identity and peer list as the board
+struct __attribute__((packed)) CaptureInfo {
+    uint8_t userState;
+    uint8_t peerCount;
+    // Followed by peerCount CapturePeer entries
+};
+
+struct __attribute__((packed)) CapturePeer {
+    uint8_t mac[6];
+    char initials[2];
+};
+
+#endif // CAPTURE_FORMAT_H
@@ -1,7 +1,5 @@
-#define DEBUG_MODE 1
 // filepath: /Users/kenglien/Documents/Arduino/HikingBoard/EspCommunication.cpp
 #include <Communication.h>
-#include "Display.h"
 #include "Device.h"
 #include "Message.h"
 #include <esp_now.h>
@@ -9,22 +7,58 @@
 #include <vector>
 #include <cstring>
 #include "Utility.h"
-static const uint8_t PAIRING_CODE = 99;
+#include "Power.h"
+#include "DutyCycle.h"
+#include "UrgentDelivery.h"
+#include "TxQueue.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "Pairing.h"
+#include "Roster.h"
+#include "ShortText.h"
+#include "SeenMap.h"
+#include "WireFrame.h"
+#include "RxLimit.h"
+#include "Gateway.h"
+#include "Custody.h"
+#include "Route.h"
+#include "Profile.h"
+#include "esp_wifi.h"
 const uint8_t broadcastAddress[MAC_SIZE] = { 0xFF,0xFF,0xFF,0xFF,0xFF,0xFF };
 
 // Placeholder for data send callback
 void dataSendCallback(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    txOnSendComplete();
+    urgentDeliveryOnSendResult(mac_addr, status);
+    powerWake(); // The loop pumps the next queued frame and schedules retries
     if (status == ESP_NOW_SEND_SUCCESS) {
         //digitalWrite(RED_LED_PIN, HIGH); // Turn on blue LED
     } else {
         //digitalWrite(RED_LED_PIN, LOW);  // Turn off blue LED on failure
-        Serial.println("Send Status: Fail");
+        metricInc(METRIC_SEND_FAILURES);
+        TRACE_WARN(TRACE_SEND_FAIL, 0, 0);
     }
 }
 
 // Placeholder for data receive callback (updated signature for ESP-NOW v5)
 void dataRecvCallback(const esp_now_recv_info_t *recv_info, const uint8_t *data, int data_len) {
-    ParseMessages(data, data_len);
+    int8_t rssi = recv_info->rx_ctrl ? recv_info->rx_ctrl->rssi : 0;
+    captureFrame(CAPTURE_RX, recv_info->src_addr, rssi, data, data_len);
+    const uint8_t* body;
+    int bodyLen;
+    WireType type = wireOpen(data, data_len, &body, &bodyLen);
+    // One noisy sender must not keep everyone else parsing and writing flash
+    if (type != WIRE_INVALID && !rxAdmit(recv_info->src_addr, type, body, bodyLen, millis())) {
+        type = WIRE_INVALID;
+    }
+    switch (type) {
+        case WIRE_STATE: ParseMessages(body, bodyLen, rssi); break;
+        case WIRE_PAIRING: pairingOnFrame(body, bodyLen); break;
+        case WIRE_ROSTER: rosterOnFrame(body, bodyLen); break;
+        default: break; // Foreign or corrupt, counted by wireOpen
+    }
+    powerWake(); // Let the UI pick up inbox changes without waiting for a deadline
 }
 
 void espSetup() {
@@ -52,41 +86,57 @@ void espSetup() {
     }
 }
 
+void radioSetEnabled(bool on) {
+    esp_err_t result = on ? esp_wifi_start() : esp_wifi_stop();
+    if (result != ESP_OK) {
+        TRACE_ERROR(TRACE_RADIO_ERROR, (uint32_t)result, on ? 1 : 0);
+    }
+}
+
+// Self, a full carry list, every custody slot and the duty beacon in one frame
+static_assert(WIRE_HEADER_LEN + (2 + CARRY_LIMIT + CUSTODY_SLOTS) * (MAC_SIZE + 1) <= TX_FRAME_MAX,
+              "status records must fit one frame");
+
 void broadcastMessages() {
+    PROFILE_SCOPE(PROF_BROADCAST);
     // Get user state and MAC address
     MessageStruct selfMsg;
     selfMsg.code = device.getUserState();
     const uint8_t* deviceMAC = device.getMACAddress(); 
     memcpy(selfMsg.sender, deviceMAC, MAC_SIZE);
 
-    // Prepare broadcast payload: selfMsg + carryMsg
+    // Prepare broadcast payload: selfMsg + carried records
     std::vector<MessageStruct> payload;
     payload.push_back(selfMsg);
-    std::vector<MessageStruct>& carry = device.getCarryMsg();
-    payload.insert(payload.end(), carry.begin(), carry.end());
+    device.expireCarryMsg(millis());
+    MessageStruct carry[CARRY_LIMIT];
+    int carryCount = device.copyCarryMsg(carry, CARRY_LIMIT);
+    payload.insert(payload.end(), carry, carry + carryCount);
+    // Urgent states in our custody, unless the carry list already has them
+    MessageStruct held[CUSTODY_SLOTS];
+    int heldCount = custodyRecords(held, CUSTODY_SLOTS);
+    for (int h = 0; h < heldCount; ++h) {
+        bool present = false;
+        for (const MessageStruct& m : payload) {
+            if (memcmp(m.sender, held[h].sender, MAC_SIZE) == 0) present = true;
+        }
+        if (!present) payload.push_back(held[h]);
+    }
+    MessageStruct beacon;
+    if (dutyBeaconRecord(beacon)) {
+        payload.push_back(beacon);
+    }
 
-#if DEBUG_MODE
-    Serial.print("[DEBUG] Broadcast payload size: ");
-    Serial.println(payload.size());
     for (size_t i = 0; i < payload.size(); ++i) {
-        Serial.print("[DEBUG] Msg ");
-        Serial.print(i);
-        Serial.print(": code=");
-        Serial.print(payload[i].code);
-        Serial.print(", sender=");
-        for (int j = 0; j < MAC_SIZE; ++j) {
-            if (j > 0) Serial.print(":");
-            Serial.printf("%02X", payload[i].sender[j]);
-        }
-        Serial.println();
+        TRACE_DEBUG_RECORD(TRACE_TX_RECORD, payload[i].sender, payload[i].code, (uint8_t)i);
     }
-#endif
 
     // Send via ESP-NOW
     // Convert payload to flat buffer for ESP-NOW
     std::vector<uint8_t> flatBuf;
-    size_t totalSize = payload.size() * (MAC_SIZE + sizeof(uint8_t));
+    size_t totalSize = WIRE_HEADER_LEN + payload.size() * (MAC_SIZE + sizeof(uint8_t));
     flatBuf.reserve(totalSize); // Pre-allocate for efficiency
+    flatBuf.resize(WIRE_HEADER_LEN); // Filled in by wireSeal
     
     for (const auto& msg : payload) {
         // Insert MAC address bytes (6 bytes)
@@ -95,58 +145,100 @@ void broadcastMessages() {
         // Insert code as 1 byte
         flatBuf.push_back(msg.code);
     }
-    
-    Serial.print("[DEBUG] ESP-NOW payload size: ");
-    Serial.println(flatBuf.size());
-    esp_err_t result = esp_now_send(broadcastAddress, flatBuf.data(), flatBuf.size());
-    if (result != ESP_OK) {
-        Serial.print("ESP-NOW send failed, error code: ");
-        Serial.println(result);
+    // Seen-by bitmaps, directed records, then free text, fill what the status records left of the frame
+    if (flatBuf.size() < TX_FRAME_MAX) {
+        size_t used = flatBuf.size();
+        flatBuf.resize(TX_FRAME_MAX);
+        used += seenAppend(flatBuf.data() + used, TX_FRAME_MAX - used, millis());
+        used += routeAppend(flatBuf.data() + used, TX_FRAME_MAX - used, millis());
+        used += shortTextAppend(flatBuf.data() + used, TX_FRAME_MAX - used, millis());
+        flatBuf.resize(used);
     }
+    
+    wireSeal(flatBuf.data(), WIRE_STATE, flatBuf.size() - WIRE_HEADER_LEN);
+    TRACE_DEBUG(TRACE_TX_FRAME, payload.size(), flatBuf.size());
+    // A newer state frame replaces one still waiting for a send credit
+    txEnqueue(broadcastAddress, flatBuf.data(), flatBuf.size(), TX_PRIO_NORMAL, TX_KEY_STATE);
+    txPump();
 }
 
-// Parse received messages and update carryMsg and inbox
-void ParseMessages(const uint8_t* data, int data_len) {
+// Parse the body of a received state frame and update the carry list and inbox
+void ParseMessages(const uint8_t* data, int data_len, int8_t rssi) {
+    PROFILE_SCOPE(PROF_PARSE);
     const int singleMsgSize = MAC_SIZE + sizeof(uint8_t);
 
-    if (data_len % singleMsgSize != 0) return; // Invalid payload
-    int msgCount = data_len / singleMsgSize;
-    if (msgCount < 1) return;
-    std::vector<MessageStruct> msgs(msgCount);
-    // Parse each message
-    for (int i = 0; i < msgCount; i++) {
-        size_t offset = i * singleMsgSize;
-        
-        // Bounds check
-        if (offset + singleMsgSize > static_cast<size_t>(data_len)) {
-            Serial.println("[ERROR] Message parsing bounds exceeded");
-            return;
-        }
-        
+    metricInc(METRIC_FRAMES_RECEIVED);
+    if (data_len % singleMsgSize != 0) { // Invalid payload
+        metricInc(METRIC_PARSE_REJECTS);
+        TRACE_WARN(TRACE_RX_REJECT, (uint32_t)data_len, 1);
+        return;
+    }
+    if (data_len < singleMsgSize) {
+        metricInc(METRIC_PARSE_REJECTS);
+        TRACE_WARN(TRACE_RX_REJECT, (uint32_t)data_len, 2);
+        return;
+    }
+    std::vector<MessageStruct> msgs;
+    msgs.reserve(data_len / singleMsgSize);
+    // Parse each message; text and seen records are followed by their body slots
+    for (int offset = 0; offset < data_len; offset += singleMsgSize) {
+        MessageStruct msg;
         // Copy MAC address to sender array (6 bytes)
-        memcpy(msgs[i].sender, data + offset, MAC_SIZE);
+        memcpy(msg.sender, data + offset, MAC_SIZE);
         
         // Copy code value (1 byte)
-        msgs[i].code = *(data + offset + MAC_SIZE);
-#if DEBUG_MODE
-        Serial.print("[DEBUG] Parsed Msg ");
-        Serial.print(i);
-        Serial.print(": code=");
-        Serial.print(msgs[i].code);
-        Serial.print(", sender=");
-        for (int j = 0; j < MAC_SIZE; j++) {
-            if (j > 0) Serial.print(":");
-            Serial.printf("%02X", msgs[i].sender[j]);
+        msg.code = *(data + offset + MAC_SIZE);
+        TRACE_DEBUG_RECORD(TRACE_RX_RECORD, msg.sender, msg.code, (uint8_t)msgs.size());
+        if (msg.code == TEXT_CODE) {
+            const uint8_t* body = data + offset + singleMsgSize;
+            int available = data_len - offset - singleMsgSize;
+            int slots = shortTextBodySlots(body, available);
+            if (offset == 0 || slots == 0) { // The sender's own state must come first
+                metricInc(METRIC_PARSE_REJECTS);
+                TRACE_WARN(TRACE_RX_REJECT, (uint32_t)data_len, 3);
+                return;
+            }
+            if (shortTextOnRecord(msg.sender, body, slots * singleMsgSize)) {
+                device.addOrUpdateInboxIfPeer(msg);
+                gatewayOnText(msg.sender);
+            }
+            offset += slots * singleMsgSize;
+            continue;
+        }
+        if (msg.code == SEEN_CODE) {
+            if (offset == 0 || data_len - offset - singleMsgSize < SEEN_BODY_LEN) {
+                metricInc(METRIC_PARSE_REJECTS);
+                TRACE_WARN(TRACE_RX_REJECT, (uint32_t)data_len, 3);
+                return;
+            }
+            seenOnRecord(msg.sender, data + offset + singleMsgSize);
+            offset += SEEN_BODY_LEN;
+            continue;
+        }
+        if (msg.code == DIRECT_CODE) {
+            if (offset == 0 || data_len - offset - singleMsgSize < DIRECT_BODY_LEN) {
+                metricInc(METRIC_PARSE_REJECTS);
+                TRACE_WARN(TRACE_RX_REJECT, (uint32_t)data_len, 3);
+                return;
+            }
+            routeOnRecord(data, msg.sender, data + offset + singleMsgSize);
+            offset += DIRECT_BODY_LEN;
+            continue;
         }
-        Serial.println();
-#endif
+        msgs.push_back(msg);
     }
+    int msgCount = msgs.size();
+    TRACE_DEBUG(TRACE_RX_FRAME, (uint32_t)msgCount, (uint32_t)data_len);
+    dutyOnFrame(msgs.data(), msgCount, millis());
+    routeOnFrame(msgs.data(), msgCount, millis());
     // --- CarryMsg FIFO update ---
     device.addOrUpdateCarryMsg(msgs[0]); 
-    device.checkPairingRequest(msgs[0]); 
     // --- Inbox update (local storage, unique by sender MAC, only if peer) ---
     for (int i = 0; i < msgCount; i++) {
         device.addOrUpdateInboxIfPeer(msgs[i]);
+        seenOnState(msgs[i].sender, msgs[i].code);
+        custodyOnRecord(msgs[i], i == 0);
+        gatewayOnRecord(msgs[0].sender, msgs[i].sender, msgs[i].code, rssi, (uint8_t)i);
     }
-    device.saveToNVS(); // Save inbox and carryMsg after changes
+    device.requestSave(); // Flushed from the loop, coalescing bursts of frames
 }
\ No newline at end of file
@@ -22,6 +22,9 @@ void dataSendCallback(const uint8_t *mac_addr, esp_now_send_status_t status);
 void dataRecvCallback(const esp_now_recv_info_t *recv_info, const uint8_t *data, int data_len);
 void espSetup();
 void broadcastMessages();
-void ParseMessages(const uint8_t *data, int data_len);
+// Start or stop the Wi-Fi radio; ESP-NOW peers survive a stop/start cycle
+void radioSetEnabled(bool on);
+// rssi is of the carrying frame, only used for the gateway stream
+void ParseMessages(const uint8_t *data, int data_len, int8_t rssi = 0);
 
 #endif // ESP_COMMUNICATION_H
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <Arduino.h>
+#include "Console.h"
+#include "Power.h"
+#include "UrgentDelivery.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "Roster.h"
+#include "ShortText.h"
+#include "SeenMap.h"
+#include "Custody.h"
+#include "Route.h"
+#include "Profile.h"
+#include "WireFrame.h"
+
+struct ConsoleCommand {
+    const char* name;
+    void (*handler)(const char* args);
+};
+
+static void cmdEnergy(const char*) { powerPrintReport(Serial); }
+static void cmdDelivery(const char*) {
+    urgentDeliveryPrintReport(Serial);
+    seenPrintReport(Serial);
+}
+static void cmdMetrics(const char*) { metricsPrint(Serial); }
+// "trace on" streams binary trace records for tools/trace_decode, "trace off" stops
+static void cmdTrace(const char* args) {
+    traceSetStreaming(strcmp(args, "on") == 0);
+}
+// "capture" writes the frame ring as pcap for tools/replay, "capture clear" empties it
+static void cmdCapture(const char* args) {
+    if (strcmp(args, "clear") == 0) captureClear();
+    else captureDump(Serial);
+}
+static void cmdHeap(const char*) {
+    Serial.printf("{\"free_heap\":%u,\"min_free_heap\":%u,\"max_alloc\":%u,\"sketch_bytes\":%u}\n",
+                  (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap(),
+                  (unsigned)ESP.getMaxAllocHeap(), (unsigned)ESP.getSketchSize());
+}
+// "profile" writes the span ring as Chrome trace JSON, "profile clear" empties it
+static void cmdProfile(const char* args) {
+    if (strcmp(args, "clear") == 0) profileClear();
+    else profileDump(Serial);
+}
+static void cmdRoster(const char*) { rosterPrintReport(Serial); }
+static void cmdCustody(const char*) { custodyPrintReport(Serial); }
+// "text MSG" sets our free text, "text -" clears it, bare "text" lists the held texts
+static void cmdText(const char* args) {
+    if (*args == '\0') shortTextPrintReport(Serial);
+    else if (!shortTextCompose(strcmp(args, "-") == 0 ? "" : args)) Serial.println("text too long");
+}
+// "route MAC CODE" sends CODE to one hiker only, bare "route" lists routes and queued records
+static void cmdRoute(const char* args) {
+    if (*args == '\0') {
+        routePrintReport(Serial);
+        return;
+    }
+    uint8_t dest[MAC_SIZE];
+    unsigned code;
+    if (sscanf(args, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx %u", &dest[0], &dest[1], &dest[2], &dest[3], &dest[4], &dest[5],
+               &code) != 7 || code > 0xFF || !(messageInfo(code).flags & MSG_SELECTABLE)) {
+        Serial.println("usage: route XX:XX:XX:XX:XX:XX CODE");
+        return;
+    }
+    if (!routeSend(dest, (uint8_t)code)) Serial.println("route queue full");
+}
+// "group NAME" moves this board to another party's group, "group -" back to the
+// default, bare "group" prints the group id
+static void cmdGroup(const char* args) {
+    if (*args != '\0' && !wireSetGroup(strcmp(args, "-") == 0 ? "" : args)) {
+        Serial.println("group name too long");
+        return;
+    }
+    Serial.printf("{\"group\":\"%04x\"}\n", wireGroup());
+}
+static void cmdHelp(const char*);
+
+static const ConsoleCommand commands[] = {
+    {"help", cmdHelp},
+    {"energy", cmdEnergy},
+    {"delivery", cmdDelivery},
+    {"metrics", cmdMetrics},
+    {"heap", cmdHeap},
+    {"trace", cmdTrace},
+    {"capture", cmdCapture},
+    {"profile", cmdProfile},
+    {"roster", cmdRoster},
+    {"custody", cmdCustody},
+    {"text", cmdText},
+    {"route", cmdRoute},
+    {"group", cmdGroup},
+};
+static const int commandCount = sizeof(commands) / sizeof(commands[0]);
+
+static void cmdHelp(const char*) {
+    for (int i = 0; i < commandCount; ++i) {
+        Serial.println(commands[i].name);
+    }
+}
+
+static char lineBuf[64];
+static int lineLen = 0;
+
+static void onSerialReceive() {
+    powerWake();
+}
+
+void consoleSetup() {
+    Serial.onReceive(onSerialReceive);
+}
+
+void consolePoll() {
+    while (Serial.available() > 0) {
+        char c = (char)Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (lineLen < (int)sizeof(lineBuf) - 1) lineBuf[lineLen++] = c;
+            continue;
+        }
+        lineBuf[lineLen] = '\0';
+        lineLen = 0;
+        // Split "name args..." at the first space
+        char* args = strchr(lineBuf, ' ');
+        if (args) *args++ = '\0';
+        for (int i = 0; i < commandCount; ++i) {
+            if (strcmp(lineBuf, commands[i].name) == 0) {
+                commands[i].handler(args ? args : "");
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Line-based serial commands for reading a unit out with a laptop
+void consoleSetup();
+void consolePoll();
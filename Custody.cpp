@@ -0,0 +1,285 @@
+#include "Custody.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Metrics.h"
+#include "Power.h"
+#include "Utility.h"
+#include <nvs.h>
+
+static const char* NVS_NAMESPACE = "hiking";
+static const char* NVS_KEY_FORMAT = "cust%d"; // One key per slot, so a change rewrites only its slot
+#define NVS_KEY_LEN 16 // NVS key names are at most 15 characters
+static const uint8_t CUSTODY_RECORD_VERSION = 1;
+
+// NVS layout of one slot
+struct __attribute__((packed)) CustodyRecord {
+    uint8_t version;
+    uint8_t code;
+    uint8_t origin[MAC_SIZE];
+    uint32_t seq; // Increases with every write, across reboots
+};
+
+struct CustodySlot {
+    bool used;
+    CustodyRecord rec;
+    uint32_t mentionedMs; // Custody taken, or the origin itself last heard urgent
+};
+
+// A change from the radio callback, committed by the loop
+struct PendingChange {
+    uint8_t origin[MAC_SIZE];
+    uint8_t code;
+    bool release;
+};
+
+// Recent all-clears from origins themselves and TTL expiries, RAM only
+struct Release {
+    bool used;
+    uint8_t origin[MAC_SIZE];
+    uint32_t atMs;
+    uint32_t holdMs; // Relays of this origin are ignored this long
+};
+
+static CustodySlot slots[CUSTODY_SLOTS];
+static PendingChange pending[CUSTODY_PENDING];
+static int pendingCount = 0;
+static Release releases[CUSTODY_SLOTS];
+static int releaseNext = 0;
+static uint32_t nextSeq = 1;
+static portMUX_TYPE custodyMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool macIs(const uint8_t* a, const uint8_t* b) { return memcmp(a, b, MAC_SIZE) == 0; }
+
+static int findSlot(const uint8_t* origin) {
+    for (int i = 0; i < CUSTODY_SLOTS; ++i) {
+        if (slots[i].used && macIs(slots[i].rec.origin, origin)) return i;
+    }
+    return -1;
+}
+
+static int findPending(const uint8_t* origin) {
+    for (int i = 0; i < pendingCount; ++i) {
+        if (macIs(pending[i].origin, origin)) return i;
+    }
+    return -1;
+}
+
+static void slotKey(int slot, char* key) {
+    snprintf(key, NVS_KEY_LEN, NVS_KEY_FORMAT, slot);
+}
+
+void custodySetup() {
+    memset(slots, 0, sizeof(slots));
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    uint32_t now = millis();
+    bool erased = false;
+    for (int i = 0; i < CUSTODY_SLOTS; ++i) {
+        char key[NVS_KEY_LEN];
+        slotKey(i, key);
+        CustodyRecord rec;
+        size_t len = sizeof(rec);
+        if (nvs_get_blob(handle, key, &rec, &len) != ESP_OK) continue;
+        if (len != sizeof(rec) || rec.version != CUSTODY_RECORD_VERSION || !isUrgentCode(rec.code)) {
+            nvs_erase_key(handle, key);
+            erased = true;
+            continue;
+        }
+        if (rec.seq >= nextSeq) nextSeq = rec.seq + 1;
+        // The same origin in two slots: the later write wins
+        int dup = findSlot(rec.origin);
+        if (dup >= 0) {
+            int loser = slots[dup].rec.seq > rec.seq ? i : dup;
+            char loserKey[NVS_KEY_LEN];
+            slotKey(loser, loserKey);
+            nvs_erase_key(handle, loserKey);
+            erased = true;
+            if (loser == i) continue;
+            slots[dup].used = false;
+        }
+        slots[i].used = true;
+        slots[i].rec = rec;
+        slots[i].mentionedMs = now; // Give restored entries a full TTL
+    }
+    if (erased && nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+    nvs_close(handle);
+}
+
+// Called with custodyMux held
+static void queueChange(const uint8_t* origin, uint8_t code, bool release) {
+    int p = findPending(origin);
+    if (p < 0) {
+        if (pendingCount == CUSTODY_PENDING) {
+            metricInc(METRIC_CUSTODY_DROPS);
+            return;
+        }
+        p = pendingCount++;
+    }
+    memcpy(pending[p].origin, origin, MAC_SIZE);
+    pending[p].code = code;
+    pending[p].release = release;
+}
+
+static bool releasedRecently(const uint8_t* origin, uint32_t nowMs) {
+    for (int i = 0; i < CUSTODY_SLOTS; ++i) {
+        const Release& r = releases[i];
+        if (r.used && macIs(r.origin, origin) && nowMs - r.atMs < r.holdMs) return true;
+    }
+    return false;
+}
+
+// Called with custodyMux held
+static void noteRelease(const uint8_t* origin, uint32_t nowMs, uint32_t holdMs) {
+    Release& r = releases[releaseNext];
+    releaseNext = (releaseNext + 1) % CUSTODY_SLOTS;
+    r.used = true;
+    memcpy(r.origin, origin, MAC_SIZE);
+    r.atMs = nowMs;
+    r.holdMs = holdMs;
+}
+
+void custodyOnRecord(const MessageStruct& msg, bool direct) {
+    bool urgent = isUrgentCode(msg.code);
+    if (!urgent && !direct) return;
+    if (macIs(msg.sender, device.getMACAddress())) return; // Our own state is not relayed custody
+    uint32_t now = millis();
+    portENTER_CRITICAL(&custodyMux);
+    int s = findSlot(msg.sender);
+    if (urgent) {
+        // Only the origin keeps an entry alive. Custodians relay each other's
+        // copies, so counting relays would keep a slot forever.
+        if (s >= 0 && direct) slots[s].mentionedMs = now;
+        bool queued = findPending(msg.sender) >= 0;
+        if (direct) {
+            if (s < 0 || slots[s].rec.code != msg.code || queued) queueChange(msg.sender, msg.code, false);
+        } else if (s < 0 && !queued && !releasedRecently(msg.sender, now)) {
+            // Relays only fill a gap; a stale copy must not override the origin
+            queueChange(msg.sender, msg.code, false);
+        }
+    } else if (s >= 0 || findPending(msg.sender) >= 0) {
+        // The origin itself says it is fine
+        noteRelease(msg.sender, now, CUSTODY_REARM_MS);
+        queueChange(msg.sender, msg.code, true);
+    }
+    portEXIT_CRITICAL(&custodyMux);
+}
+
+// Lowest severity, then oldest write
+static int pickVictim() {
+    int victim = 0;
+    for (int i = 1; i < CUSTODY_SLOTS; ++i) {
+        uint8_t sev = MessageSeverity(slots[i].rec.code);
+        uint8_t victimSev = MessageSeverity(slots[victim].rec.code);
+        if (sev < victimSev || (sev == victimSev && (int32_t)(slots[i].rec.seq - slots[victim].rec.seq) < 0)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+static void commitSlot(nvs_handle_t handle, int slot, const CustodyRecord* rec) {
+    char key[NVS_KEY_LEN];
+    slotKey(slot, key);
+    if (rec) nvs_set_blob(handle, key, rec, sizeof(*rec));
+    else nvs_erase_key(handle, key);
+    if (nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+}
+
+static void apply(nvs_handle_t handle, const PendingChange& c, uint32_t nowMs) {
+    int slot = findSlot(c.origin);
+    bool held = slot >= 0;
+    if (c.release) {
+        if (slot < 0) return;
+        commitSlot(handle, slot, nullptr);
+        portENTER_CRITICAL(&custodyMux);
+        slots[slot].used = false;
+        portEXIT_CRITICAL(&custodyMux);
+        return;
+    }
+    if (slot < 0) {
+        for (int i = 0; i < CUSTODY_SLOTS && slot < 0; ++i) {
+            if (!slots[i].used) slot = i;
+        }
+    }
+    if (slot < 0) {
+        slot = pickVictim();
+        if (MessageSeverity(slots[slot].rec.code) > MessageSeverity(c.code)) {
+            metricInc(METRIC_CUSTODY_DROPS);
+            return;
+        }
+        metricInc(METRIC_CUSTODY_EVICTIONS);
+    }
+    CustodyRecord rec;
+    rec.version = CUSTODY_RECORD_VERSION;
+    rec.code = c.code;
+    memcpy(rec.origin, c.origin, MAC_SIZE);
+    rec.seq = nextSeq++;
+    // Write ahead: on flash before it is relayed
+    commitSlot(handle, slot, &rec);
+    portENTER_CRITICAL(&custodyMux);
+    slots[slot].used = true;
+    slots[slot].rec = rec;
+    // A code change keeps the TTL the origin's reports already set
+    if (!held) slots[slot].mentionedMs = nowMs;
+    portEXIT_CRITICAL(&custodyMux);
+}
+
+void custodyTick(uint32_t nowMs) {
+    portENTER_CRITICAL(&custodyMux);
+    for (int i = 0; i < CUSTODY_SLOTS; ++i) {
+        if (slots[i].used && nowMs - slots[i].mentionedMs >= CUSTODY_TTL_MS && findPending(slots[i].rec.origin) < 0) {
+            // Other custodians still relay it; only the origin can re-arm it now
+            noteRelease(slots[i].rec.origin, nowMs, CUSTODY_TTL_MS);
+            queueChange(slots[i].rec.origin, 0, true);
+        }
+    }
+    bool any = pendingCount > 0;
+    portEXIT_CRITICAL(&custodyMux);
+    if (!any) return;
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    for (;;) {
+        PendingChange c;
+        portENTER_CRITICAL(&custodyMux);
+        bool have = pendingCount > 0;
+        if (have) {
+            c = pending[0];
+            memmove(pending, pending + 1, (pendingCount - 1) * sizeof(pending[0]));
+            pendingCount--;
+        }
+        portEXIT_CRITICAL(&custodyMux);
+        if (!have) break;
+        apply(handle, c, nowMs);
+    }
+    nvs_close(handle);
+}
+
+uint32_t custodyMsUntilNext(uint32_t) {
+    return pendingCount > 0 ? 0 : POWER_NO_DEADLINE;
+}
+
+int custodyRecords(MessageStruct* out, int max) {
+    int n = 0;
+    portENTER_CRITICAL(&custodyMux);
+    for (int i = 0; i < CUSTODY_SLOTS && n < max; ++i) {
+        if (!slots[i].used) continue;
+        memcpy(out[n].sender, slots[i].rec.origin, MAC_SIZE);
+        out[n].code = slots[i].rec.code;
+        n++;
+    }
+    portEXIT_CRITICAL(&custodyMux);
+    return n;
+}
+
+void custodyPrintReport(Print& out) {
+    uint32_t now = millis();
+    out.printf("custody next_seq=%lu pending=%d\n", (unsigned long)nextSeq, pendingCount);
+    for (int i = 0; i < CUSTODY_SLOTS; ++i) {
+        if (!slots[i].used) continue;
+        char mac[MAC_STRING_LEN];
+        out.printf("slot=%d origin=%s code=%s seq=%lu mentioned_s=%lu\n", i, macToString(slots[i].rec.origin, mac),
+                   MessageMapping(slots[i].rec.code), (unsigned long)slots[i].rec.seq,
+                   (unsigned long)((now - slots[i].mentionedMs) / 1000));
+    }
+}
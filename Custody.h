@@ -0,0 +1,38 @@
+// Custody.h
+#ifndef CUSTODY_H
+#define CUSTODY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "Message.h"
+
+// Urgent states (SOS, INJURED) this board has taken custody of while relaying.
+// They survive a brownout or battery swap: each entry lives under its own NVS
+// key and is committed to flash before the board starts relaying it, so what
+// is on the air is never ahead of what is on flash. At boot the slots are read
+// back, checked and de-duplicated by sequence number.
+//
+// The origin itself is authoritative: a non-urgent state heard directly from
+// it releases custody and its urgent reports set the code. Relayed states can
+// only take custody of an origin not held yet, and not right after the origin
+// itself said it is fine, so stale carry lists around the group cannot flip a
+// slot back and forth (and wear the flash). Only the origin's own reports
+// keep an entry alive; once its TTL runs out, relayed copies cannot take
+// custody again for another TTL.
+#define CUSTODY_SLOTS 8
+#define CUSTODY_PENDING 8                    // Changes waiting for the loop to commit them
+#define CUSTODY_REARM_MS (5UL * 60UL * 1000UL) // Relays ignored after the origin's all-clear
+#define CUSTODY_TTL_MS (6UL * 60UL * 60UL * 1000UL) // Released when the origin is not heard urgent this long
+
+void custodySetup();
+// Feed every parsed status record; direct is true when the sender is the origin.
+// Safe from the radio callbacks; flash work is deferred to custodyTick.
+void custodyOnRecord(const MessageStruct& msg, bool direct);
+// Commit pending changes to flash, then apply them; call from the loop
+void custodyTick(uint32_t nowMs);
+uint32_t custodyMsUntilNext(uint32_t nowMs);
+// Records in custody for the broadcast, at most max; returns the count
+int custodyRecords(MessageStruct* out, int max);
+void custodyPrintReport(Print& out);
+
+#endif // CUSTODY_H
@@ -2,20 +2,20 @@
 #include "Device.h"
 #include "Communication.h"
 #include "Utility.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Profile.h"
 #include <map>
 #include <vector>
 #include <cstring>
-#include <sstream>
-#include <iomanip>
-#include <string>
 #include <vector>
 #include <esp_system.h>
 #include "esp_wifi.h"
 #include <nvs.h>
 #include <nvs_flash.h>
 
-static const uint8_t PAIRING_CODE = 99;
 Device device;
+static portMUX_TYPE carryMux = portMUX_INITIALIZER_UNLOCKED;
 
 void deviceSetup() {
     uint8_t mac[6];
@@ -25,7 +25,7 @@ void deviceSetup() {
 
 // User State
 
-Device::Device() : userState(0), inbox(), carryMsg(), peerList() {
+Device::Device() : userState(0), inbox(), peerList() {
     uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
     addPeer(broadcast, "BB"); 
     // Initialize peerList with two addresses
@@ -40,58 +40,78 @@ Device::Device() : userState(0), inbox(), carryMsg(), peerList() {
     loadFromNVS();
 }
 // Message management
-std::vector<MessageStruct>& Device::getInbox() {
+const Inbox& Device::getInbox() const {
     return inbox;
 }
 
-std::vector<MessageStruct>& Device::getCarryMsg() {
-    return carryMsg;
+int Device::copyCarryMsg(MessageStruct* out, int max) const {
+    portENTER_CRITICAL(&carryMux);
+    int n = carryCount < max ? carryCount : max;
+    for (int i = 0; i < n; ++i) out[i] = carry[i].msg;
+    portEXIT_CRITICAL(&carryMux);
+    return n;
 }
 
-// Track minutes since received for each inbox message
-const std::vector<uint16_t>& Device::getInboxReceivedMins() const {
-    return inboxReceivedMins;
-}
-
-// Add or update a message in carryMsg (FIFO, by sender MAC)
+// Add or update a carried record (by sender MAC); when full the lowest relay
+// priority goes first, the oldest among equals. Called from the receive callback.
 void Device::addOrUpdateCarryMsg(const MessageStruct& msg) {
-    if (msg.code == PAIRING_CODE) return;
-
-    auto it = std::find_if(carryMsg.begin(), carryMsg.end(), [&](const MessageStruct& m) {
-        return memcmp(m.sender, msg.sender, MAC_SIZE) == 0;
-    });
-    if (it != carryMsg.end()) {
-        *it = msg;
-    } else {
-        if ((int)carryMsg.size() >= CARRY_LIMIT) {
-            carryMsg.erase(carryMsg.begin());
+    if (isControlCode(msg.code)) return;
+    uint32_t now = millis();
+    bool evicted = false;
+
+    portENTER_CRITICAL(&carryMux);
+    int slot = -1;
+    for (int i = 0; i < carryCount && slot < 0; ++i) {
+        if (memcmp(carry[i].msg.sender, msg.sender, MAC_SIZE) == 0) slot = i;
+    }
+    if (slot < 0 && carryCount >= CARRY_LIMIT) {
+        int victim = 0;
+        for (int i = 1; i < carryCount; ++i) {
+            if (messageRelayPriority(carry[i].msg.code) < messageRelayPriority(carry[victim].msg.code)) victim = i;
         }
-        carryMsg.push_back(msg);
+        if (messageRelayPriority(carry[victim].msg.code) > messageRelayPriority(msg.code)) {
+            portEXIT_CRITICAL(&carryMux);
+            return;
+        }
+        // Keep the rest in arrival order
+        memmove(&carry[victim], &carry[victim + 1], (carryCount - victim - 1) * sizeof(carry[0]));
+        carryCount--;
+        evicted = true;
+    }
+    if (slot < 0) slot = carryCount++;
+    carry[slot].msg = msg;
+    carry[slot].heardMs = now;
+    portEXIT_CRITICAL(&carryMux);
+
+    if (evicted) metricInc(METRIC_CARRY_EVICTIONS);
+}
+
+// Stop relaying records not heard again within their code's TTL
+void Device::expireCarryMsg(uint32_t nowMs) {
+    portENTER_CRITICAL(&carryMux);
+    int kept = 0;
+    for (int i = 0; i < carryCount; ++i) {
+        if (nowMs - carry[i].heardMs >= messageRelayTtlMs(carry[i].msg.code)) continue;
+        if (kept != i) carry[kept] = carry[i];
+        kept++;
     }
+    carryCount = kept;
+    portEXIT_CRITICAL(&carryMux);
+}
+
+void Device::clearCarryMsg() {
+    portENTER_CRITICAL(&carryMux);
+    carryCount = 0;
+    portEXIT_CRITICAL(&carryMux);
 }
 
 // Add or update a message in inbox (by sender MAC, only if sender is peer)
 void Device::addOrUpdateInboxIfPeer(const MessageStruct& msg) {
     if (!isPeer(msg.sender)) return;
-    if (msg.code == PAIRING_CODE) return; // Don't add pairing messages to inbox
+    if (isControlCode(msg.code)) return; // Don't add control codes to inbox
     uint16_t now_min = (uint16_t)(millis() / 60000);
-
-    // Only match sender and code, ignore data
-    auto sameMsgIt = std::find_if(inbox.begin(), inbox.end(), [&](const MessageStruct& m) {
-        return memcmp(m.sender, msg.sender, MAC_SIZE) == 0 &&
-               m.code == msg.code;
-    });
-
-    if (sameMsgIt != inbox.end()) {
-        size_t idx = std::distance(inbox.begin(), sameMsgIt);
-        if (idx < inboxReceivedMins.size()) {
-            inboxReceivedMins[idx] = now_min;
-        }
-    } else {
-        inbox.push_back(msg);
-        inboxReceivedMins.push_back(now_min);
-    }
-    device.inboxUpdated = true;
+    inbox.addOrUpdate(msg.sender, msg.code, now_min);
+    inboxTouches++;
 }
 
 // Remove a peer by index (excluding broadcast)
@@ -99,6 +119,7 @@ void Device::removePeerByIndex(int idx) {
     // idx is 0-based, but index 0 is broadcast, so idx >= 1
     if (idx <= 0 || idx >= (int)peerList.size()) return;
     peerList.erase(peerList.begin() + idx);
+    peersGeneration++;
     saveToNVS();
 }
 
@@ -122,26 +143,24 @@ const uint8_t* Device::getMACAddress() const {
 // Peer Management
 
 // Modified peerList to store PeerInfo
-void Device::addPeer(const uint8_t* macAddress, const std::string& initials) {
-    std::string peerInitials = initials;
-    if (peerInitials.empty()) {
-        // Default to last two hex digits of MAC
-        std::ostringstream oss;
-        oss << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-            << static_cast<int>(macAddress[MAC_SIZE-2])
-            << static_cast<int>(macAddress[MAC_SIZE-1]);
-        peerInitials = oss.str();
-    }
+void Device::addPeer(const uint8_t* macAddress, const char* initials) {
     PeerInfo info;
     memcpy(info.mac, macAddress, MAC_SIZE);
-    info.initials = peerInitials;
+    if (initials && initials[0]) {
+        strncpy(info.initials, initials, INITIALS_LEN - 1);
+        info.initials[INITIALS_LEN - 1] = '\0';
+    } else {
+        macToInitials(macAddress, info.initials); // Default to the last byte in hex
+    }
     peerList.push_back(info);
+    peersGeneration++;
     device.clearPendingPairMAC();
     saveToNVS(); // Save peers after change
 }
 
 void Device::clearPeerList() {
     peerList.clear();
+    peersGeneration++;
     uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
     addPeer(broadcast, "BB");
     clearInbox();
@@ -150,8 +169,6 @@ void Device::clearPeerList() {
 
 void Device::clearInbox() {
     inbox.clear();
-    inboxReceivedMins.clear();
-    inboxUpdated = true;
     saveToNVS();
 }
 
@@ -168,7 +185,7 @@ bool Device::isPeer(const uint8_t* macAddress) const {
     return false;
 }
 
-// Call this from ParseMessages when in pairing mode
+// Called for pairing frames while in pairing mode
 void Device::checkPairingRequest(const MessageStruct& msg) {
     if (getUserState() != PAIRING_CODE || msg.code != PAIRING_CODE) return;
     if (isPeer(msg.sender)) return;
@@ -181,9 +198,11 @@ void Device::checkPairingRequest(const MessageStruct& msg) {
 void Device::setPendingPairMAC(const std::array<uint8_t, MAC_SIZE>& mac) {
     pendingPairMAC = mac;
     pendingPair = true;
+    pairingGeneration++;
 }
 
 void Device::clearPendingPairMAC() {
+    if (pendingPair) pairingGeneration++;
     pendingPairMAC.fill(0);
     pendingPair = false;
 }
@@ -217,39 +236,42 @@ bool Device::isDeclinedPairMAC(const std::array<uint8_t, MAC_SIZE>& mac) const {
     return false;
 }
 
-std::string Device::MACToInitials(const uint8_t* macAddress) const {
+char* Device::MACToInitials(const uint8_t* macAddress, char* out) const {
     for (const auto& peer : peerList) {
         if (memcmp(peer.mac, macAddress, MAC_SIZE) == 0) {
-            return peer.initials;
+            memcpy(out, peer.initials, INITIALS_LEN);
+            return out;
         }
     }
-    // Return last two hex digits of MAC address if not found
-    std::ostringstream oss;
-    oss << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-        << static_cast<int>(macAddress[MAC_SIZE-2])
-        << static_cast<int>(macAddress[MAC_SIZE-1]);
-    return oss.str();
+    // Return the last byte of the MAC address in hex if not found
+    return macToInitials(macAddress, out);
 }
 
 // Helper functions for NVS serialization
 static const char* NVS_NAMESPACE = "hiking";
-static const char* NVS_KEY_INBOX = "inbox";
-static const char* NVS_KEY_INBOX_TIME = "inbox_time";
+static const char* NVS_KEY_INBOX_RECORDS = "inbox_rec";
+static const char* NVS_KEY_INBOX = "inbox";           // Pre-ring layout, migrated on load
+static const char* NVS_KEY_INBOX_TIME = "inbox_time"; // Pre-ring layout, migrated on load
 static const char* NVS_KEY_PEERS = "peers";
+static_assert(sizeof(Device::PeerInfo) == MAC_SIZE + INITIALS_LEN, "peer entries are stored in NVS as-is");
 static const char* NVS_KEY_INBOX_MILLIS = "inbox_millis"; // store minutes since boot
 
 // Save inbox and peer list to NVS
 void Device::saveToNVS() {
+    PROFILE_SCOPE(PROF_NVS_SAVE);
     nvs_handle_t handle;
+    savePending = false; // A full save covers any deferred request
     if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
 
-    // Save inbox
-    size_t inboxLen = inbox.size() * sizeof(MessageStruct);
-    nvs_set_blob(handle, NVS_KEY_INBOX, inbox.data(), inboxLen);
-
-    // Save inboxReceivedMins
-    size_t minsLen = inboxReceivedMins.size() * sizeof(uint16_t);
-    nvs_set_blob(handle, NVS_KEY_INBOX_TIME, inboxReceivedMins.data(), minsLen);
+    // Save inbox records, oldest first
+    std::vector<InboxRecord> records;
+    records.reserve(inbox.size());
+    for (size_t i = 0; i < inbox.size(); ++i) {
+        records.push_back(inbox.at(i));
+    }
+    nvs_set_blob(handle, NVS_KEY_INBOX_RECORDS, records.data(), records.size() * sizeof(InboxRecord));
+    nvs_erase_key(handle, NVS_KEY_INBOX);
+    nvs_erase_key(handle, NVS_KEY_INBOX_TIME);
 
     // Save reference time in minutes since boot using esp_timer_get_time()
     uint32_t refMinutes = (uint32_t)(esp_timer_get_time() / 1000000ULL / 60ULL);
@@ -258,79 +280,86 @@ void Device::saveToNVS() {
     // Save peerList
     // Store as: [PeerInfo][PeerInfo]...
     size_t peerCount = peerList.size();
-    struct PeerNVS {
-        uint8_t mac[MAC_SIZE];
-        char initials[3];
-    };
-    std::vector<PeerNVS> peersNVS;
-    for (const auto& peer : peerList) {
-        PeerNVS p;
-        memcpy(p.mac, peer.mac, MAC_SIZE);
-        strncpy(p.initials, peer.initials.c_str(), 2);
-        p.initials[2] = '\0';
-        peersNVS.push_back(p);
-    }
-    nvs_set_blob(handle, NVS_KEY_PEERS, peersNVS.data(), peersNVS.size() * sizeof(PeerNVS));
+    nvs_set_blob(handle, NVS_KEY_PEERS, peerList.data(), peerCount * sizeof(PeerInfo));
 
-    nvs_commit(handle);
+    if (nvs_commit(handle) == ESP_OK) {
+        metricInc(METRIC_NVS_COMMITS);
+        TRACE_INFO(TRACE_NVS_COMMIT, records.size(), peerCount);
+    }
     nvs_close(handle);
 }
 
+void Device::requestSave() {
+    if (savePending) return;
+    saveDueMs = millis() + NVS_FLUSH_DELAY_MS;
+    savePending = true;
+}
+
+void Device::flushIfDue(uint32_t nowMs) {
+    if (!savePending || (int32_t)(nowMs - saveDueMs) < 0) return;
+    savePending = false;
+    saveToNVS();
+}
+
+uint32_t Device::msUntilFlush(uint32_t nowMs) const {
+    if (!savePending) return 0xFFFFFFFFUL;
+    int32_t left = (int32_t)(saveDueMs - nowMs);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
 // Load inbox and peer list from NVS
 void Device::loadFromNVS() {
+    PROFILE_SCOPE(PROF_NVS_LOAD);
     nvs_handle_t handle;
     if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
 
-    // Load inbox
-    size_t inboxLen = 0;
-    if (nvs_get_blob(handle, NVS_KEY_INBOX, NULL, &inboxLen) == ESP_OK && inboxLen % sizeof(MessageStruct) == 0) {
-        inbox.resize(inboxLen / sizeof(MessageStruct));
-        nvs_get_blob(handle, NVS_KEY_INBOX, inbox.data(), &inboxLen);
-    }
-
-    // Load inboxReceivedMins
-    size_t minsLen = 0;
-    if (nvs_get_blob(handle, NVS_KEY_INBOX_TIME, NULL, &minsLen) == ESP_OK && minsLen % sizeof(uint16_t) == 0) {
-        size_t count = minsLen / sizeof(uint16_t);
-        inboxReceivedMins.resize(count);
-        nvs_get_blob(handle, NVS_KEY_INBOX_TIME, inboxReceivedMins.data(), &minsLen);
+    // Load inbox records
+    std::vector<InboxRecord> records;
+    size_t recordsLen = 0;
+    if (nvs_get_blob(handle, NVS_KEY_INBOX_RECORDS, NULL, &recordsLen) == ESP_OK && recordsLen % sizeof(InboxRecord) == 0) {
+        records.resize(recordsLen / sizeof(InboxRecord));
+        nvs_get_blob(handle, NVS_KEY_INBOX_RECORDS, records.data(), &recordsLen);
     } else {
-        inboxReceivedMins.clear();
-    }
-
-    // Ensure inboxReceivedMins matches inbox size
-    if (inboxReceivedMins.size() != inbox.size()) {
-        inboxReceivedMins.resize(inbox.size(), 0);
+        // Migrate the old parallel inbox / inbox_time blobs
+        size_t inboxLen = 0;
+        std::vector<MessageStruct> oldInbox;
+        if (nvs_get_blob(handle, NVS_KEY_INBOX, NULL, &inboxLen) == ESP_OK && inboxLen % sizeof(MessageStruct) == 0) {
+            oldInbox.resize(inboxLen / sizeof(MessageStruct));
+            nvs_get_blob(handle, NVS_KEY_INBOX, oldInbox.data(), &inboxLen);
+        }
+        std::vector<uint16_t> oldMins(oldInbox.size(), 0);
+        size_t minsLen = 0;
+        if (nvs_get_blob(handle, NVS_KEY_INBOX_TIME, NULL, &minsLen) == ESP_OK && minsLen == oldMins.size() * sizeof(uint16_t)) {
+            nvs_get_blob(handle, NVS_KEY_INBOX_TIME, oldMins.data(), &minsLen);
+        }
+        for (size_t i = 0; i < oldInbox.size(); ++i) {
+            InboxRecord r;
+            memcpy(r.sender, oldInbox[i].sender, MAC_SIZE);
+            r.code = oldInbox[i].code;
+            r.receivedMin = oldMins[i];
+            records.push_back(r);
+        }
     }
+    // Keep only what fits in the ring
+    size_t skip = records.size() > INBOX_LIMIT ? records.size() - INBOX_LIMIT : 0;
+    inbox.restore(records.data() + skip, records.size() - skip);
 
-    // Load and adjust inboxReceivedMins by minutes reference
+    // Load and adjust received times by minutes reference
     uint32_t savedMinutes = 0;
     if (nvs_get_u32(handle, NVS_KEY_INBOX_MILLIS, &savedMinutes) == ESP_OK && savedMinutes > 0) {
         uint32_t nowMinutes = (uint32_t)(esp_timer_get_time() / 1000000ULL / 60ULL);
-        int32_t minDiff = (int32_t)(nowMinutes - savedMinutes);
-        for (auto& t : inboxReceivedMins) {
-            int32_t adjusted = (int32_t)t + minDiff;
-            t = (adjusted >= 0) ? (uint16_t)adjusted : 0;
-        }
+        inbox.adjustTimes((int32_t)(nowMinutes - savedMinutes));
     }
 
     // Load peerList
     size_t peersLen = 0;
-    struct PeerNVS {
-        uint8_t mac[MAC_SIZE];
-        char initials[3];
-    };
-    if (nvs_get_blob(handle, NVS_KEY_PEERS, NULL, &peersLen) == ESP_OK && peersLen % sizeof(PeerNVS) == 0) {
-        size_t peerCount = peersLen / sizeof(PeerNVS);
-        std::vector<PeerNVS> peersNVS(peerCount);
-        nvs_get_blob(handle, NVS_KEY_PEERS, peersNVS.data(), &peersLen);
-        peerList.clear();
-        for (const auto& p : peersNVS) {
-            PeerInfo info;
-            memcpy(info.mac, p.mac, MAC_SIZE);
-            info.initials = std::string(p.initials);
-            peerList.push_back(info);
+    if (nvs_get_blob(handle, NVS_KEY_PEERS, NULL, &peersLen) == ESP_OK && peersLen % sizeof(PeerInfo) == 0) {
+        peerList.resize(peersLen / sizeof(PeerInfo));
+        nvs_get_blob(handle, NVS_KEY_PEERS, peerList.data(), &peersLen);
+        for (auto& peer : peerList) {
+            peer.initials[INITIALS_LEN - 1] = '\0';
         }
+        peersGeneration++;
     }
 
     nvs_close(handle);
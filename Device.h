@@ -5,11 +5,13 @@
 #include <stdint.h>
 #include <vector>
 #include <map>
-#include <string>
 
 #include "Message.h"
+#include "Inbox.h"
+#include "Utility.h"
 #define RED_LED_PIN 1
 #define CARRY_LIMIT 15
+#define NVS_FLUSH_DELAY_MS 5000 // Coalesce saves requested by received traffic
 class Device;
 extern Device device;
 void deviceSetup();
@@ -29,23 +31,28 @@ public:
     // Peer management
     struct PeerInfo {
         uint8_t mac[MAC_SIZE];
-        std::string initials;
+        char initials[INITIALS_LEN]; // Also the NVS layout of a peer entry
     };
     
         // Remove a peer by index (excluding broadcast)
     void removePeerByIndex(int idx);
-    void addPeer(const uint8_t* macAddress, const std::string& initials = "");
+    void addPeer(const uint8_t* macAddress, const char* initials = nullptr);
     bool isPeer(const uint8_t* macAddress) const;
-    std::string MACToInitials(const uint8_t *macAddress) const;
+    // Writes the peer's initials (or a hex fallback) into out, returns out
+    char* MACToInitials(const uint8_t* macAddress, char* out) const;
     const std::vector<PeerInfo>& getPeerList() const;
     void clearPeerList();
     void clearInbox();
 
     // Message management
-    std::vector<MessageStruct>& getInbox();
-    std::vector<MessageStruct>& getCarryMsg();
-    // Add or update a message in carryMsg (FIFO, by sender MAC)
+    const Inbox& getInbox() const;
+    // Copy the carried records into out, at most max; returns the count
+    int copyCarryMsg(MessageStruct* out, int max) const;
+    // Add or update a carried record (by sender MAC, evicting by relay priority)
     void addOrUpdateCarryMsg(const MessageStruct& msg);
+    // Drop carried records older than their code's relay TTL
+    void expireCarryMsg(uint32_t nowMs);
+    void clearCarryMsg();
     // Add or update a message in inbox (by sender MAC, only if sender is peer)
     void addOrUpdateInboxIfPeer(const MessageStruct& msg);
     // Pairing request handling
@@ -59,22 +66,39 @@ public:
     void clearDeclinedPairMACs();
     const std::vector<std::array<uint8_t, MAC_SIZE>>& getDeclinedPairMACs() const;
     bool isDeclinedPairMAC(const std::array<uint8_t, MAC_SIZE>& mac) const;
-    // Track minutes since received for each inbox message
-    const std::vector<uint16_t>& getInboxReceivedMins() const;
     void saveToNVS();
     void loadFromNVS();
-    bool inboxUpdated = false; // Flag to indicate inbox was updated
+    // Deferred save: coalesces bursts of received traffic into one NVS commit
+    void requestSave();
+    void flushIfDue(uint32_t nowMs);
+    uint32_t msUntilFlush(uint32_t nowMs) const;
+    // Change notification: views compare these against what they last drew
+    uint32_t getPeersGeneration() const { return peersGeneration; }
+    uint32_t getPairingGeneration() const { return pairingGeneration; }
+    // Inbox updates received, including ones that changed nothing visible
+    uint32_t getInboxTouches() const { return inboxTouches; }
 private:
     uint8_t userState;
     uint8_t macAddress[MAC_SIZE];  // Device MAC address
     std::vector<PeerInfo> peerList; // List of peers (MAC + initials)
-    std::vector<MessageStruct> inbox;
-    std::vector<MessageStruct> carryMsg;
-    std::vector<uint16_t> inboxReceivedMins;
+    Inbox inbox;
+    // Written by the receive callback and the loop; guarded by carryMux in Device.cpp
+    struct CarryEntry {
+        MessageStruct msg;
+        uint32_t heardMs;
+    };
+    CarryEntry carry[CARRY_LIMIT];
+    int carryCount = 0;
     // Pairing state
     bool pendingPair = false;
     std::array<uint8_t, MAC_SIZE> pendingPairMAC = {0};
     std::vector<std::array<uint8_t, MAC_SIZE>> declinedPairMACs;
+    volatile uint32_t peersGeneration = 0;
+    volatile uint32_t pairingGeneration = 0;
+    volatile uint32_t inboxTouches = 0;
+    // Deferred NVS save
+    volatile bool savePending = false;
+    volatile uint32_t saveDueMs = 0;
 };
 
 #endif // DEVICE_H
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <Arduino.h>
+#include "DutyCycle.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Power.h"
+
+#ifdef USE_DUTY_CYCLE
+
+// The schedule follows the lowest MAC heard (the root). Each board sends
+// its frame at a fixed, MAC-derived offset into the window, so a receiver
+// can tell where the sender's window started from the arrival time alone.
+// Only frames sent in that slot carry the beacon, so nothing else moves the phase.
+static uint8_t rootMAC[MAC_SIZE];     // Guarded by dutyMux, with the two below
+static uint32_t windowOriginMs = 0;   // Any past window start
+static uint32_t rootHeardMs = 0;
+static portMUX_TYPE dutyMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t urgentUntilMs = 0;
+static uint32_t lastSentWindowMs = 0;
+static bool sentThisWindow = false;
+static bool beaconDue = false;        // The frame being built goes out in our slot
+static bool radioOn = true;
+
+static uint32_t txOffsetMs(const uint8_t* mac) {
+    return DUTY_TX_OFFSET_MS + (mac[MAC_SIZE - 1] % DUTY_TX_SLOTS) * DUTY_TX_SLOT_MS;
+}
+
+// Called with dutyMux held. Signed distance from the schedule origin, folded into [-period/2, period/2)
+static int32_t phaseError(uint32_t ms) {
+    int32_t error = (int32_t)(ms - windowOriginMs) % (int32_t)DUTY_PERIOD_MS;
+    if (error >= (int32_t)DUTY_PERIOD_MS / 2) error -= DUTY_PERIOD_MS;
+    if (error < -(int32_t)DUTY_PERIOD_MS / 2) error += DUTY_PERIOD_MS;
+    return error;
+}
+
+// Called with dutyMux held
+static uint32_t windowStart(uint32_t nowMs) {
+    int32_t into = (int32_t)(nowMs - windowOriginMs) % (int32_t)DUTY_PERIOD_MS;
+    if (into < 0) into += DUTY_PERIOD_MS;
+    return nowMs - (uint32_t)into;
+}
+
+// Called with dutyMux held
+static bool isSelfRoot() {
+    return memcmp(rootMAC, device.getMACAddress(), MAC_SIZE) == 0;
+}
+
+static void setRadio(bool on) {
+    if (on == radioOn) return;
+    radioOn = on;
+    radioSetEnabled(on);
+    powerSetRadioOn(on);
+}
+
+void dutySetup() {
+    portENTER_CRITICAL(&dutyMux);
+    memcpy(rootMAC, device.getMACAddress(), MAC_SIZE);
+    windowOriginMs = millis();
+    rootHeardMs = windowOriginMs;
+    portEXIT_CRITICAL(&dutyMux);
+}
+
+void dutyOnFrame(const MessageStruct* msgs, int count, uint32_t rxMs) {
+    for (int i = 0; i < count; ++i) {
+        if (isUrgentCode(msgs[i].code)) {
+            urgentUntilMs = rxMs + DUTY_URGENT_HOLD_MS;
+        }
+        if (msgs[i].code != SYNC_CODE) continue;
+        const uint8_t* root = msgs[i].sender;
+        if (memcmp(root, device.getMACAddress(), MAC_SIZE) == 0) continue;
+        // msgs[0] is always the sending board's own record
+        uint32_t senderStart = rxMs - txOffsetMs(msgs[0].sender);
+        portENTER_CRITICAL(&dutyMux);
+        int cmp = memcmp(root, rootMAC, MAC_SIZE);
+        if (cmp < 0) {
+            memcpy(rootMAC, root, MAC_SIZE);
+            windowOriginMs = senderStart;
+        } else if (cmp == 0) {
+            // Same root: correct half of the drift to avoid chasing jitter
+            windowOriginMs += phaseError(senderStart) / 2;
+        }
+        if (cmp <= 0) rootHeardMs = rxMs;
+        portEXIT_CRITICAL(&dutyMux);
+    }
+}
+
+static bool urgentActive(uint32_t nowMs) {
+    if (isUrgentCode(device.getUserState())) return true;
+    if ((int32_t)(urgentUntilMs - nowMs) > 0) return true;
+    MessageStruct carry[CARRY_LIMIT];
+    int carryCount = device.copyCarryMsg(carry, CARRY_LIMIT);
+    for (int i = 0; i < carryCount; ++i) {
+        if (isUrgentCode(carry[i].code)) return true;
+    }
+    return false;
+}
+
+bool dutyUpdate(uint32_t nowMs) {
+    portENTER_CRITICAL(&dutyMux);
+    if (!isSelfRoot() && nowMs - rootHeardMs > DUTY_ROOT_TIMEOUT_PERIODS * DUTY_PERIOD_MS) {
+        memcpy(rootMAC, device.getMACAddress(), MAC_SIZE);
+    }
+    portEXIT_CRITICAL(&dutyMux);
+    // Pairing and urgent traffic run on the normal always-listening schedule
+    if (device.getUserState() == PAIRING_CODE || urgentActive(nowMs)) {
+        setRadio(true);
+        return false;
+    }
+    portENTER_CRITICAL(&dutyMux);
+    uint32_t start = windowStart(nowMs);
+    windowOriginMs = start; // Keep the origin recent so the signed math never wraps
+    portEXIT_CRITICAL(&dutyMux);
+    // Drift corrections move the start by a few ms; only a new period resets the send
+    if ((int32_t)(start - lastSentWindowMs) >= (int32_t)DUTY_PERIOD_MS / 2) {
+        lastSentWindowMs = start;
+        sentThisWindow = false;
+    }
+    setRadio(nowMs - start < DUTY_WINDOW_MS);
+    return true;
+}
+
+bool dutyBroadcastDue(uint32_t nowMs) {
+    if (!radioOn || sentThisWindow) return false;
+    portENTER_CRITICAL(&dutyMux);
+    uint32_t start = windowStart(nowMs);
+    portEXIT_CRITICAL(&dutyMux);
+    if (nowMs - start < txOffsetMs(device.getMACAddress())) return false;
+    sentThisWindow = true;
+    beaconDue = true;
+    return true;
+}
+
+uint32_t dutyMsUntilNextEvent(uint32_t nowMs) {
+    portENTER_CRITICAL(&dutyMux);
+    uint32_t start = windowStart(nowMs);
+    portEXIT_CRITICAL(&dutyMux);
+    uint32_t intoWindow = nowMs - start;
+    uint32_t txAt = txOffsetMs(device.getMACAddress());
+    if (!sentThisWindow && intoWindow < txAt) return txAt - intoWindow;
+    if (intoWindow < DUTY_WINDOW_MS) return DUTY_WINDOW_MS - intoWindow;
+    return DUTY_PERIOD_MS - intoWindow;
+}
+
+bool dutyBeaconRecord(MessageStruct& out) {
+    // Off-schedule frames (urgent, pairing) would drag receivers' phase
+    if (!beaconDue) return false;
+    beaconDue = false;
+    portENTER_CRITICAL(&dutyMux);
+    memcpy(out.sender, rootMAC, MAC_SIZE);
+    portEXIT_CRITICAL(&dutyMux);
+    out.code = SYNC_CODE;
+    return true;
+}
+
+#else
+
+void dutySetup() {}
+void dutyOnFrame(const MessageStruct*, int, uint32_t) {}
+bool dutyUpdate(uint32_t) { return false; }
+bool dutyBroadcastDue(uint32_t) { return false; }
+uint32_t dutyMsUntilNextEvent(uint32_t) { return POWER_NO_DEADLINE; }
+bool dutyBeaconRecord(MessageStruct&) { return false; }
+
+#endif // USE_DUTY_CYCLE
@@ -0,0 +1,33 @@
+// DutyCycle.h
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <stdint.h>
+#include "Message.h"
+
+// Uncomment the next line to let boards share a wake schedule and keep the
+// radio off outside short listen windows. Urgent traffic overrides it.
+//#define USE_DUTY_CYCLE
+
+#define DUTY_PERIOD_MS 10000       // One listen window per period
+#define DUTY_WINDOW_MS 500         // Radio on time at the start of each period
+#define DUTY_TX_OFFSET_MS 40       // Send this long after the window opens
+#define DUTY_TX_SLOT_MS 20         // Per-board send jitter step, chosen from the MAC
+#define DUTY_TX_SLOTS 8
+#define DUTY_ROOT_TIMEOUT_PERIODS 6 // Forget a schedule root not heard for this long
+#define DUTY_URGENT_HOLD_MS 60000  // Stay fully awake after seeing an urgent code
+
+void dutySetup();
+// Feed every parsed frame: aligns the schedule and notices urgent traffic
+void dutyOnFrame(const MessageStruct* msgs, int count, uint32_t rxMs);
+// Applies the schedule for nowMs. Returns false when the board should run
+// its normal always-listening broadcast loop instead.
+bool dutyUpdate(uint32_t nowMs);
+// True once per window, when this board's send slot has come
+bool dutyBroadcastDue(uint32_t nowMs);
+uint32_t dutyMsUntilNextEvent(uint32_t nowMs);
+// Record appended to the frame sent in our slot so neighbours can align to
+// our schedule; false for frames sent off-schedule
+bool dutyBeaconRecord(MessageStruct& out);
+
+#endif // DUTY_CYCLE_H
@@ -0,0 +1,104 @@
+// EnergyModel.h
+// Per-state current model shared by the firmware's energy accounting and the
+// host battery estimator (tools/battery_estimate.cpp). No Arduino dependencies.
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+
+enum PowerState : uint8_t {
+    POWER_ACTIVE,      // CPU running, radio listening
+    POWER_IDLE,        // CPU waiting for a deadline, radio listening
+    POWER_LIGHT_SLEEP, // CPU and radio suspended
+    POWER_RADIO_OFF,   // CPU waiting, radio stopped between duty-cycle windows
+    POWER_TX,          // Radio transmitting (charged on top of the other states)
+    POWER_STATE_COUNT
+};
+
+// Typical ESP32-S3 draw in microamps, taken from the datasheet figures
+static const uint32_t POWER_STATE_CURRENT_UA[POWER_STATE_COUNT] = {
+    100000, // POWER_ACTIVE
+    80000,  // POWER_IDLE
+    300,    // POWER_LIGHT_SLEEP
+    20000,  // POWER_RADIO_OFF
+    340000, // POWER_TX
+};
+static const char* const POWER_STATE_NAMES[POWER_STATE_COUNT] = {
+    "active", "idle", "sleep", "radiooff", "tx"
+};
+// SSD1306 with a typical amount of lit pixels, always on
+static const uint32_t DISPLAY_CURRENT_UA = 10000;
+
+struct EnergyAccount {
+    uint64_t stateUs[POWER_STATE_COUNT] = {0};
+    uint32_t txFrames = 0;
+};
+
+// On-air time of one ESP-NOW frame at the default 1 Mbps rate:
+// long preamble plus 802.11 action frame overhead plus payload
+inline uint32_t energyAirtimeUs(uint16_t payloadBytes) {
+    return 192 + (uint32_t)(payloadBytes + 43) * 8;
+}
+
+inline uint64_t energyTotalUs(const EnergyAccount& acc) {
+    uint64_t total = 0;
+    for (int s = 0; s < POWER_STATE_COUNT; ++s) {
+        if (s != POWER_TX) total += acc.stateUs[s];
+    }
+    return total;
+}
+
+// Average current in milliamps over the accounted time
+inline double energyAverageCurrentMa(const EnergyAccount& acc) {
+    uint64_t total = energyTotalUs(acc);
+    if (total == 0) return 0.0;
+    double uaUs = 0.0;
+    for (int s = 0; s < POWER_STATE_COUNT; ++s) {
+        uaUs += (double)acc.stateUs[s] * POWER_STATE_CURRENT_UA[s];
+    }
+    // TX time was also accounted in the state it overlapped; remove that share
+    uaUs -= (double)acc.stateUs[POWER_TX] * POWER_STATE_CURRENT_UA[POWER_ACTIVE];
+    return (uaUs / (double)total + DISPLAY_CURRENT_UA) / 1000.0;
+}
+
+inline double energyBatteryLifeHours(double averageMa, double batteryMah) {
+    if (averageMa <= 0.0) return 0.0;
+    return batteryMah / averageMa;
+}
+
+// Models one hour of a fixed broadcast schedule: each wakeup spends activeUs
+// of CPU time and sends one frame, the rest is idle or light sleep
+inline EnergyAccount energyModelSchedule(uint32_t broadcastIntervalMs, uint16_t frameBytes,
+                                         uint32_t activeUs, bool lightSleep) {
+    EnergyAccount acc;
+    const uint64_t hourUs = 3600ULL * 1000000ULL;
+    uint64_t wakeups = hourUs / ((uint64_t)broadcastIntervalMs * 1000ULL);
+    uint64_t active = wakeups * activeUs;
+    if (active > hourUs) active = hourUs;
+    acc.stateUs[POWER_ACTIVE] = active;
+    acc.stateUs[lightSleep ? POWER_LIGHT_SLEEP : POWER_IDLE] = hourUs - active;
+    acc.stateUs[POWER_TX] = wakeups * energyAirtimeUs(frameBytes);
+    acc.txFrames = (uint32_t)wakeups;
+    return acc;
+}
+
+// Models one hour of synchronized duty cycling: the radio listens for windowMs
+// out of every periodMs and one frame is sent per window
+inline EnergyAccount energyModelDutyCycle(uint32_t periodMs, uint32_t windowMs, uint16_t frameBytes,
+                                          uint32_t activeUs) {
+    EnergyAccount acc;
+    const uint64_t hourUs = 3600ULL * 1000000ULL;
+    if (windowMs > periodMs) windowMs = periodMs;
+    uint64_t windows = hourUs / ((uint64_t)periodMs * 1000ULL);
+    uint64_t active = windows * activeUs;
+    uint64_t listening = windows * windowMs * 1000ULL;
+    if (listening < active) listening = active;
+    acc.stateUs[POWER_ACTIVE] = active;
+    acc.stateUs[POWER_IDLE] = listening - active;
+    acc.stateUs[POWER_RADIO_OFF] = hourUs - listening;
+    acc.stateUs[POWER_TX] = windows * energyAirtimeUs(frameBytes);
+    acc.txFrames = (uint32_t)windows;
+    return acc;
+}
+
+#endif // ENERGY_MODEL_H
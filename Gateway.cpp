@@ -0,0 +1,98 @@
+#include "Gateway.h"
+#include "Device.h"
+#include "Metrics.h"
+#include "Power.h"
+#include "ShortText.h"
+
+#ifdef GATEWAY_MODE
+
+// Encoded frames waiting for the UART; whole frames go in or are dropped
+static uint8_t ring[GATEWAY_RING_BYTES];
+static uint16_t ringHead = 0; // Next byte to write
+static uint16_t ringCount = 0;
+static uint32_t lastHelloMs = 0;
+static bool helloSent = false;
+static portMUX_TYPE gatewayMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void push(uint8_t type, const void* payload, unsigned len) {
+    uint8_t frame[GATEWAY_MAX_FRAME];
+    unsigned n = gatewayEncode(type, payload, len, frame);
+    portENTER_CRITICAL(&gatewayMux);
+    if (ringCount + n > GATEWAY_RING_BYTES) {
+        portEXIT_CRITICAL(&gatewayMux);
+        metricInc(METRIC_GATEWAY_DROPS);
+        return;
+    }
+    for (unsigned i = 0; i < n; ++i) ring[(ringHead + i) % GATEWAY_RING_BYTES] = frame[i];
+    ringHead = (ringHead + n) % GATEWAY_RING_BYTES;
+    ringCount += n;
+    portEXIT_CRITICAL(&gatewayMux);
+}
+
+void gatewayOnRecord(const uint8_t* relay, const uint8_t* origin, uint8_t code, int8_t rssi, uint8_t index) {
+    GatewayRecord rec;
+    rec.timeMs = millis();
+    memcpy(rec.relay, relay, 6);
+    memcpy(rec.origin, origin, 6);
+    rec.code = code;
+    rec.rssi = rssi;
+    rec.index = index;
+    push(GATEWAY_RECORD, &rec, sizeof(rec));
+}
+
+void gatewayOnText(const uint8_t* origin) {
+    uint8_t payload[sizeof(GatewayText) + TEXT_MAX_CHARS + 1];
+    GatewayText head;
+    head.timeMs = millis();
+    memcpy(head.origin, origin, 6);
+    memcpy(payload, &head, sizeof(head));
+    char* text = (char*)payload + sizeof(head);
+    if (!shortTextFrom(origin, text, TEXT_MAX_CHARS + 1)) return;
+    push(GATEWAY_TEXT, payload, sizeof(head) + strlen(text));
+}
+
+void gatewayDrain(uint32_t nowMs) {
+    if (!helloSent || nowMs - lastHelloMs >= GATEWAY_HELLO_MS) {
+        GatewayHello hello;
+        memcpy(hello.mac, device.getMACAddress(), 6);
+        hello.version = GATEWAY_VERSION;
+        hello.reserved = 0;
+        hello.uptimeMs = nowMs;
+        hello.drops = metricGet(METRIC_GATEWAY_DROPS);
+        push(GATEWAY_HELLO, &hello, sizeof(hello));
+        lastHelloMs = nowMs;
+        helloSent = true;
+    }
+    for (;;) {
+        // Never block the loop on a full UART buffer
+        int room = Serial.availableForWrite();
+        if (room <= 0) return;
+        uint8_t chunk[128];
+        unsigned n = 0;
+        portENTER_CRITICAL(&gatewayMux);
+        uint16_t tail = (ringHead + GATEWAY_RING_BYTES - ringCount) % GATEWAY_RING_BYTES;
+        while (n < sizeof(chunk) && (int)n < room && n < ringCount) {
+            chunk[n] = ring[(tail + n) % GATEWAY_RING_BYTES];
+            n++;
+        }
+        ringCount -= n;
+        portEXIT_CRITICAL(&gatewayMux);
+        if (n == 0) return;
+        Serial.write(chunk, n);
+    }
+}
+
+uint32_t gatewayMsUntilDrain(uint32_t nowMs) {
+    if (ringCount > 0) return GATEWAY_DRAIN_RETRY_MS;
+    uint32_t since = nowMs - lastHelloMs;
+    return since >= GATEWAY_HELLO_MS ? 0 : GATEWAY_HELLO_MS - since;
+}
+
+#else
+
+void gatewayOnRecord(const uint8_t*, const uint8_t*, uint8_t, int8_t, uint8_t) {}
+void gatewayOnText(const uint8_t*) {}
+void gatewayDrain(uint32_t) {}
+uint32_t gatewayMsUntilDrain(uint32_t) { return POWER_NO_DEADLINE; }
+
+#endif // GATEWAY_MODE
@@ -0,0 +1,32 @@
+// Gateway.h
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "GatewayFormat.h"
+
+// Uncomment the next line to build a base-station board: every record it
+// parses is streamed over USB serial for tools/gatewayd. The board otherwise
+// works as usual.
+//#define GATEWAY_MODE
+
+#ifdef GATEWAY_MODE
+#define SERIAL_BAUD 921600
+#else
+#define SERIAL_BAUD 115200
+#endif
+
+#define GATEWAY_RING_BYTES 4096   // Output buffered while the UART catches up
+#define GATEWAY_HELLO_MS 5000     // Hello interval, doubles as a heartbeat
+#define GATEWAY_DRAIN_RETRY_MS 5  // Revisit a backlog after the UART has drained a bit
+
+// Queue one parsed record; safe from the radio callbacks
+void gatewayOnRecord(const uint8_t* relay, const uint8_t* origin, uint8_t code, int8_t rssi, uint8_t index);
+// Queue the latest text from origin (see ShortText.h)
+void gatewayOnText(const uint8_t* origin);
+// Write queued frames to Serial without blocking; call from the loop
+void gatewayDrain(uint32_t nowMs);
+uint32_t gatewayMsUntilDrain(uint32_t nowMs);
+
+#endif // GATEWAY_H
@@ -0,0 +1,74 @@
+// GatewayFormat.h
+// Serial stream of a board built with GATEWAY_MODE, shared by the firmware
+// (Gateway.h), the Linux daemon (tools/gatewayd.cpp) and its stand-in board
+// (tools/gateway_sim.cpp).
+#ifndef GATEWAY_FORMAT_H
+#define GATEWAY_FORMAT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define GATEWAY_VERSION 1
+
+// Each frame is SYNC0 SYNC1 <type> <len> <len payload bytes> <crc16 LE>, the
+// CRC covering type, len and payload. Console text on the same port is
+// skipped by the reader, which resynchronizes on the sync bytes.
+#define GATEWAY_SYNC0 0xC7
+#define GATEWAY_SYNC1 0x7C
+#define GATEWAY_MAX_PAYLOAD 64
+#define GATEWAY_FRAME_OVERHEAD 6
+#define GATEWAY_MAX_FRAME (GATEWAY_MAX_PAYLOAD + GATEWAY_FRAME_OVERHEAD)
+
+enum GatewayFrameType : uint8_t {
+    GATEWAY_HELLO = 1,  // GatewayHello, sent at boot and then periodically
+    GATEWAY_RECORD = 2, // GatewayRecord, one per status record parsed
+    GATEWAY_TEXT = 3    // GatewayText header followed by the decoded text
+};
+
+struct __attribute__((packed)) GatewayHello {
+    uint8_t mac[6];      // The gateway board
+    uint8_t version;     // GATEWAY_VERSION
+    uint8_t reserved;
+    uint32_t uptimeMs;
+    uint32_t drops;      // Frames lost to a full output ring since boot
+};
+
+struct __attribute__((packed)) GatewayRecord {
+    uint32_t timeMs;     // Gateway millis() at reception
+    uint8_t relay[6];    // Board whose frame carried the record
+    uint8_t origin[6];   // Board the state belongs to
+    uint8_t code;
+    int8_t rssi;         // Of the carrying frame
+    uint8_t index;       // Position in the frame; 0 is the relay's own state
+};
+
+struct __attribute__((packed)) GatewayText {
+    uint32_t timeMs;
+    uint8_t origin[6];
+    // Text follows, not NUL terminated
+};
+
+// CRC-16/CCITT-FALSE
+inline uint16_t gatewayCrc16(const uint8_t* data, unsigned len, uint16_t crc = 0xFFFF) {
+    for (unsigned i = 0; i < len; ++i) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Frame a payload into out (GATEWAY_MAX_FRAME bytes); returns the frame length
+inline unsigned gatewayEncode(uint8_t type, const void* payload, unsigned len, uint8_t* out) {
+    if (len > GATEWAY_MAX_PAYLOAD) len = GATEWAY_MAX_PAYLOAD;
+    out[0] = GATEWAY_SYNC0;
+    out[1] = GATEWAY_SYNC1;
+    out[2] = type;
+    out[3] = (uint8_t)len;
+    memcpy(out + 4, payload, len);
+    uint16_t crc = gatewayCrc16(out + 2, len + 2);
+    out[4 + len] = (uint8_t)crc;
+    out[5 + len] = (uint8_t)(crc >> 8);
+    return len + GATEWAY_FRAME_OVERHEAD;
+}
+
+#endif // GATEWAY_FORMAT_H
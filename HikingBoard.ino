@@ -4,27 +4,90 @@
 #include "ButtonInput.h"
 #include "Menu.h"
 #include "Device.h"
+#include "Power.h"
+#include "Console.h"
+#include "DutyCycle.h"
+#include "UrgentDelivery.h"
+#include "TxQueue.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Pairing.h"
+#include "Roster.h"
+#include "Gateway.h"
+#include "Custody.h"
+#include "Profile.h"
+#include "WireFrame.h"
 
 void setup() {
-    Serial.begin(115200);
+    Serial.begin(SERIAL_BAUD);
+    powerSetup();
     espSetup();
     deviceSetup();
+    wireSetup();
+    custodySetup();
     buttonSetup();
     //device.setUserState(99);
     displaySetup();
     menuSetup();
+    consoleSetup();
+    dutySetup();
+    rosterSetup();
+    TRACE_INFO(TRACE_BOOT, 0, 0);
 }
 
 void loop() {
-    // Broadcast messages every 5 seconds, or every 1 second in pairing mode
+    // Broadcast messages every 750 ms; pairing uses its own small frames
     static unsigned long lastBroadcast = 0;
+    uint32_t loopStartUs = micros();
+    PROFILE_SCOPE_NAMED(loopSpan, PROF_LOOP);
     unsigned long now = millis();
-    unsigned long broadcastInterval = (device.getUserState() == 99) ? 50 : 750;
-    if (now - lastBroadcast >= broadcastInterval) {
+    const unsigned long broadcastInterval = 750;
+    bool dutyCycled = dutyUpdate(now);
+    if (dutyCycled) {
+        // Shared wake schedule: one frame per listen window
+        if (dutyBroadcastDue(now)) {
+            broadcastMessages();
+            lastBroadcast = now;
+        }
+    } else if (now - lastBroadcast >= broadcastInterval) {
         broadcastMessages();
         lastBroadcast = now;
     }
+    // Acknowledged unicast of our own urgent state to every peer
+    urgentDeliveryTick(now);
+    pairingTick(now);
+    rosterTick(now);
+    custodyTick(now);
+    txPump();
     // Handle button inputs
     menuLoop();
+    consolePoll();
+    device.flushIfDue(now);
+    traceDrain();
+    gatewayDrain(now);
 
+    // Sleep until the next deadline; buttons, radio and serial input wake us early
+    now = millis();
+    uint32_t waitMs;
+    if (dutyCycled) {
+        waitMs = dutyMsUntilNextEvent(now);
+    } else {
+        waitMs = lastBroadcast + broadcastInterval - now;
+        if (now - lastBroadcast >= broadcastInterval) waitMs = 0;
+    }
+    waitMs = min(waitMs, menuMsUntilRedraw(now));
+    waitMs = min(waitMs, device.msUntilFlush(now));
+    waitMs = min(waitMs, buttonMsUntilLongPress());
+    waitMs = min(waitMs, urgentDeliveryMsUntilNext(now));
+    waitMs = min(waitMs, pairingMsUntilNext(now));
+    waitMs = min(waitMs, rosterMsUntilNext(now));
+    waitMs = min(waitMs, custodyMsUntilNext(now));
+    waitMs = min(waitMs, txMsUntilNext());
+    waitMs = min(waitMs, traceMsUntilDrain());
+    waitMs = min(waitMs, gatewayMsUntilDrain(now));
+    PROFILE_SCOPE_END(loopSpan); // Not the idle wait
+    uint32_t loopUs = micros() - loopStartUs;
+    histogramRecord(HIST_LOOP_US, loopUs);
+    metricMax(METRIC_LOOP_MAX_US, loopUs);
+    powerIdle(waitMs);
 }
@@ -0,0 +1,183 @@
+#include "Inbox.h"
+#include <string.h>
+
+Inbox::Inbox() : generation(0) {
+    memset(versions, 0, sizeof(versions));
+    clear();
+}
+
+void Inbox::clear() {
+    count = 0;
+    senderCount = 0;
+    generation++;
+}
+
+Inbox::SenderIndex* Inbox::findSender(const uint8_t* mac) {
+    for (uint8_t i = 0; i < senderCount; ++i) {
+        if (memcmp(senders[i].mac, mac, MAC_SIZE) == 0) return &senders[i];
+    }
+    return nullptr;
+}
+
+const Inbox::SenderIndex* Inbox::findSender(const uint8_t* mac) const {
+    return const_cast<Inbox*>(this)->findSender(mac);
+}
+
+// Drop a ring slot from its sender's index before the slot is reused
+void Inbox::unindexSlot(uint8_t slot) {
+    SenderIndex* s = findSender(records[slot].sender);
+    if (!s) return;
+    uint8_t prev = NO_SLOT;
+    for (uint8_t cur = s->newest; cur != NO_SLOT; prev = cur, cur = olderSlot[cur]) {
+        if (cur != slot) continue;
+        if (prev == NO_SLOT) s->newest = olderSlot[cur];
+        else olderSlot[prev] = olderSlot[cur];
+        s->count--;
+        break;
+    }
+    if (s->count == 0) {
+        *s = senders[--senderCount];
+    }
+}
+
+// Link a slot in as the sender's most recently received entry
+void Inbox::indexSlot(SenderIndex* s, uint8_t slot) {
+    olderSlot[slot] = s->newest;
+    s->newest = slot;
+    s->count++;
+}
+
+// Move a slot to the most recently received end. Expects count to include it.
+void Inbox::touchSlot(uint8_t slot) {
+    uint8_t* pos = (uint8_t*)memchr(recency, slot, count);
+    if (pos) memmove(pos, pos + 1, recency + count - pos - 1);
+    recency[count - 1] = slot;
+}
+
+void Inbox::unorderSlot(uint8_t slot) {
+    uint8_t* pos = (uint8_t*)memchr(order, slot, count);
+    if (!pos) return;
+    memmove(pos, pos + 1, order + count - pos - 1);
+}
+
+// Insert ahead of every entry of equal or lower severity, so the most recent
+// entry leads its severity group. Expects count to exclude the slot.
+void Inbox::orderSlot(uint8_t slot) {
+    uint8_t severity = MessageSeverity(records[slot].code);
+    uint8_t i = 0;
+    while (i < count && MessageSeverity(records[order[i]].code) > severity) ++i;
+    memmove(&order[i + 1], &order[i], count - i);
+    order[i] = slot;
+}
+
+bool Inbox::addOrUpdate(const uint8_t* sender, uint8_t code, uint16_t nowMin) {
+    SenderIndex* s = findSender(sender);
+    if (s) {
+        for (uint8_t slot = s->newest; slot != NO_SLOT; slot = olderSlot[slot]) {
+            InboxRecord& r = records[slot];
+            if (r.code == code) {
+                touchSlot(slot);
+                // Lead the sender's history again; its timeline shows this order
+                // (the sender keeps another entry, so s stays valid)
+                if (s->newest != slot) {
+                    unindexSlot(slot);
+                    indexSlot(s, slot);
+                    generation++;
+                }
+                // Same minute: nothing else a view shows has changed
+                if (r.receivedMin == nowMin) return false;
+                r.receivedMin = nowMin;
+                versions[slot]++;
+                // Move to the front of its severity group
+                const uint8_t* before = (const uint8_t*)memchr(order, slot, count);
+                unorderSlot(slot);
+                count--;
+                orderSlot(slot);
+                count++;
+                if ((const uint8_t*)memchr(order, slot, count) != before) generation++;
+                return false;
+            }
+        }
+    }
+
+    uint8_t slot;
+    if (count == INBOX_LIMIT) {
+        // Last in priority order: lowest severity, least recently received
+        slot = order[count - 1];
+        unindexSlot(slot);
+        unorderSlot(slot);
+        uint8_t* pos = (uint8_t*)memchr(recency, slot, count);
+        memmove(pos, pos + 1, recency + count - pos - 1);
+        count--;
+        s = findSender(sender); // The sender table may have been compacted
+    } else {
+        slot = count;
+    }
+    InboxRecord& r = records[slot];
+    memcpy(r.sender, sender, MAC_SIZE);
+    r.code = code;
+    r.receivedMin = nowMin;
+    versions[slot]++;
+    orderSlot(slot);
+    recency[count] = slot;
+    count++;
+    generation++;
+
+    if (!s) {
+        s = &senders[senderCount++];
+        memcpy(s->mac, sender, MAC_SIZE);
+        s->count = 0;
+        s->newest = NO_SLOT;
+    }
+    indexSlot(s, slot);
+    return true;
+}
+
+const InboxRecord& Inbox::at(size_t i) const {
+    return records[recency[i]];
+}
+
+const InboxRecord& Inbox::byPriority(size_t i) const {
+    return records[order[i]];
+}
+
+int Inbox::priorityIndexOf(const uint8_t* sender, uint8_t code) const {
+    const SenderIndex* s = findSender(sender);
+    if (!s) return -1;
+    for (uint8_t slot = s->newest; slot != NO_SLOT; slot = olderSlot[slot]) {
+        if (records[slot].code != code) continue;
+        const uint8_t* pos = (const uint8_t*)memchr(order, slot, count);
+        return pos ? (int)(pos - order) : -1;
+    }
+    return -1;
+}
+
+uint16_t Inbox::versionByPriority(size_t i) const {
+    return versions[order[i]];
+}
+
+int Inbox::history(const uint8_t* sender, const InboxRecord** out, int max) const {
+    const SenderIndex* s = findSender(sender);
+    if (!s) return 0;
+    int n = 0;
+    for (uint8_t slot = s->newest; slot != NO_SLOT && n < max; slot = olderSlot[slot]) {
+        out[n++] = &records[slot];
+    }
+    return n;
+}
+
+void Inbox::adjustTimes(int32_t minDiff) {
+    for (uint8_t i = 0; i < count; ++i) {
+        InboxRecord& r = records[i];
+        int32_t adjusted = (int32_t)r.receivedMin + minDiff;
+        r.receivedMin = (adjusted >= 0) ? (uint16_t)adjusted : 0;
+    }
+    generation++;
+}
+
+void Inbox::restore(const InboxRecord* saved, size_t n) {
+    clear();
+    for (size_t i = 0; i < n; ++i) {
+        addOrUpdate(saved[i].sender, saved[i].code, saved[i].receivedMin);
+    }
+}
@@ -0,0 +1,84 @@
+// Inbox.h
+#ifndef INBOX_H
+#define INBOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Message.h"
+
+#define INBOX_LIMIT 32      // Capacity; when full the least urgent, least recently received entry goes
+#define INBOX_HISTORY_LEN 4 // Entries the history view shows per sender
+
+// One inbox entry, stored as-is in the ring and in NVS
+struct __attribute__((packed)) InboxRecord {
+    uint8_t sender[MAC_SIZE];
+    uint8_t code;
+    uint16_t receivedMin; // Minutes since boot when last received
+};
+
+// Bounded inbox with a per-sender index of all the sender's entries.
+// Entries are unique per (sender, code), so a repeat only refreshes the time
+// and updates walk only that sender's entries, never the whole inbox.
+// A priority order and a receive order over the slots are maintained
+// alongside; a refresh counts as receiving the entry again in both.
+class Inbox {
+public:
+    Inbox();
+
+    // Returns true if a new entry was added, false if an existing one was refreshed.
+    // A refresh within the same minute changes nothing a view can show.
+    bool addOrUpdate(const uint8_t* sender, uint8_t code, uint16_t nowMin);
+    void clear();
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // i = 0 is the least recently received entry
+    const InboxRecord& at(size_t i) const;
+    // i = 0 is the most urgent entry: highest severity, then most recently received
+    const InboxRecord& byPriority(size_t i) const;
+    // Position of the (sender, code) entry in priority order, -1 if absent
+    int priorityIndexOf(const uint8_t* sender, uint8_t code) const;
+    // Bumped when entries are added, evicted, cleared or reordered
+    uint32_t getGeneration() const { return generation; }
+    // Bumped when the entry's shown content (its received time) changes
+    uint16_t versionByPriority(size_t i) const;
+    uint16_t versionOf(const InboxRecord& r) const { return versions[&r - records]; }
+    // Up to max of the sender's entries, most recently received first; returns how many were written
+    int history(const uint8_t* sender, const InboxRecord** out, int max) const;
+    // Shift every received time, used when restoring across a reboot
+    void adjustTimes(int32_t minDiff);
+    // Rebuild from records in oldest-to-newest order
+    void restore(const InboxRecord* records, size_t n);
+
+private:
+    static const uint8_t NO_SLOT = 0xFF;
+
+    // Each sender's slots form a list, most recently received first, linked through olderSlot
+    struct SenderIndex {
+        uint8_t mac[MAC_SIZE];
+        uint8_t count;
+        uint8_t newest;
+    };
+
+    SenderIndex* findSender(const uint8_t* mac);
+    const SenderIndex* findSender(const uint8_t* mac) const;
+    void unindexSlot(uint8_t slot);
+    void indexSlot(SenderIndex* s, uint8_t slot);
+    void touchSlot(uint8_t slot);
+    void unorderSlot(uint8_t slot);
+    void orderSlot(uint8_t slot);
+
+    InboxRecord records[INBOX_LIMIT]; // Slots 0..count-1 are in use
+    uint8_t count;
+    uint8_t recency[INBOX_LIMIT]; // Slots, least recently received first
+    // Every indexed slot belongs to one sender, so INBOX_LIMIT senders always suffice
+    SenderIndex senders[INBOX_LIMIT];
+    uint8_t senderCount;
+    uint8_t olderSlot[INBOX_LIMIT]; // Next older slot of the same sender, or NO_SLOT
+    // Ring slots sorted by priority, kept sorted on every insert and refresh
+    uint8_t order[INBOX_LIMIT];
+    // Change notification, not persisted
+    uint32_t generation;
+    uint16_t versions[INBOX_LIMIT];
+};
+
+#endif // INBOX_H
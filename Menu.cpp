@@ -6,6 +6,12 @@
 #include "Communication.h"
 #include "Utility.h"
 #include "Message.h" // For MessageMapping
+#include "UrgentDelivery.h"
+#include "Metrics.h"
+#include "ShortText.h"
+#include "SeenMap.h"
+#include "Profile.h"
+#include "Route.h"
 #include <set>
 #include <algorithm>
 
@@ -16,27 +22,59 @@ enum MenuState {
     PAIRING_MODE,
     PAIRING_REQUEST,
     PAIRING_KEYBOARD,
-    PEER_LIST // Add new state
+    PEER_LIST, // Add new state
+    PAIRING_CONFIRMED,
+    TEXT_KEYBOARD,
+    ROUTE_PEER,
+    ROUTE_MSG,
+    MENU_STATE_COUNT
 };
 
 static MenuState menuState = MAIN_MENU;
 static int menuIndex = 0;
-static const char* menuItems[] = {"Inbox", "Send Msg", "Pairing", "Peers"};
-static const int menuCount = 4;
+static const char* menuItems[] = {"Inbox", "Send Msg", "Pairing", "Peers", "Direct"};
+static const int menuCount = 5;
+#define MAIN_MENU_LINES 4 // Size 2 lines that fit the panel; the list scrolls past them
 
-static uint8_t msgSelectIndex = 0;
-static const uint8_t msgCount = 8; // Only 0-7 valid codes for message select
-static const uint8_t PAIRING_CODE = 99;
+static uint8_t msgSelectIndex = 0; // Into the catalog's selectable codes, then "Text"
 
-static int inboxIndex = 0;
+#define MENU_FRAME_INTERVAL_MS 40  // At most 25 redraws per second
+#define MENU_FRAME_BUDGET_US 30000 // Frames slower than this count as overruns
+
+// The entry on screen, by identity: new and refreshed entries reorder the list under it
+static uint8_t inboxSelSender[MAC_SIZE];
+static uint8_t inboxSelCode = 0;
+static bool inboxSelValid = false;
+
+// Where the selected entry sits now; the top when there is none or it is gone
+static int inboxIndex() {
+    if (!inboxSelValid) return 0;
+    int idx = device.getInbox().priorityIndexOf(inboxSelSender, inboxSelCode);
+    return idx >= 0 ? idx : 0;
+}
+
+static void inboxSelect(int idx) {
+    const InboxRecord& r = device.getInbox().byPriority(idx);
+    memcpy(inboxSelSender, r.sender, MAC_SIZE);
+    inboxSelCode = r.code;
+    inboxSelValid = true;
+}
+
+// Push the frame buffer to the panel
+static void pushFrame() {
+    PROFILE_SCOPE(PROF_DISPLAY_PUSH);
+    display.display();
+}
 
 static void showMainMenu() {
+    PROFILE_SCOPE(PROF_SHOW_MAIN_MENU);
     // Use font size 2 for bigger text, left align, highlight with '<'
     display.clearDisplay();
     display.setTextSize(2);
     display.setTextColor(SSD1306_WHITE);
     int y = 0;
-    for (int i = 0; i < menuCount; ++i) {
+    int first = menuIndex < MAIN_MENU_LINES ? 0 : menuIndex - MAIN_MENU_LINES + 1;
+    for (int i = first; i < first + MAIN_MENU_LINES && i < menuCount; ++i) {
         display.setCursor(0, y);
         display.print(menuItems[i]);
         if (i == menuIndex) {
@@ -44,10 +82,20 @@ static void showMainMenu() {
         }
         y += 16; // 16 pixels per line for size 2
     }
-    display.display();
+    pushFrame();
+}
+
+// "12m" or "3h" since a minutes-since-boot timestamp
+static String elapsedString(uint16_t received_min, uint16_t now_min) {
+    uint16_t elapsed_min = now_min >= received_min ? now_min - received_min : 0;
+    if (elapsed_min < 60) {
+        return String(elapsed_min) + "m";
+    }
+    return String(elapsed_min / 60) + "h";
 }
 
 static void showInbox() {
+    PROFILE_SCOPE(PROF_SHOW_INBOX);
     display.clearDisplay();
     const auto& inbox = device.getInbox();
     int inboxSize = inbox.size();
@@ -68,55 +116,64 @@ static void showInbox() {
         display.setTextSize(1);
         display.setCursor(0, bottomY);
         display.print("Back");
-        display.display();
+        pushFrame();
         return;
     }
 
-    // Clamp inboxIndex
-    if (inboxIndex >= inboxSize) inboxIndex = 0;
-    if (inboxIndex < 0) inboxIndex = 0;
-
-    const MessageStruct& msg = inbox[inboxIndex];
+    // Most urgent first, so an SOS is never buried behind routine updates
+    const InboxRecord& msg = inbox.byPriority(inboxIndex());
+    uint16_t now_min = (uint16_t)(millis() / 60000);
 
     // Top left: Sender initials (font size 2)
     display.setTextSize(2);
     display.setTextColor(SSD1306_WHITE);
-    String sender = device.MACToInitials(msg.sender).c_str();
+    char sender[INITIALS_LEN];
+    device.MACToInitials(msg.sender, sender);
     display.setCursor(0, 0);
     display.print(sender);
 
     // Top right: Time since received (font size 1)
     display.setTextSize(1);
-    const auto& inboxReceivedMins = device.getInboxReceivedMins();
-    uint16_t now_min = (uint16_t)(millis() / 60000);
-    uint16_t elapsed_min = 0;
-    if (inboxIndex < inboxReceivedMins.size()) {
-        uint16_t received_min = inboxReceivedMins[inboxIndex];
-        if (now_min >= received_min) {
-            elapsed_min = now_min - received_min;
-        }
-    }
-    String timeStr;
-    if (elapsed_min < 60) {
-        timeStr = String(elapsed_min) + "m ago";
-    } else {
-        timeStr = String(elapsed_min / 60) + "h ago";
-    }
+    String timeStr = elapsedString(msg.receivedMin, now_min) + " ago";
     int16_t x1, y1;
     uint16_t w, h;
     display.getTextBounds(timeStr, 0, 0, &x1, &y1, &w, &h);
     display.setCursor(display.width() - w, 0);
     display.print(timeStr);
 
-    // Middle: Message (centered)
-    display.setTextSize(2);
-    String msgStr = MessageMapping(msg.code);
-    display.getTextBounds(msgStr, 0, 0, &x1, &y1, &w, &h);
-    int middleY = (display.height() - h) / 2;
-    display.setCursor((display.width() - w) / 2, middleY);
-    display.print(msgStr);
+    // Middle: Message (centered); free text is small and wraps over up to three lines
+    char text[TEXT_MAX_CHARS + 1];
+    int middleY;
+    if (msg.code == TEXT_CODE && shortTextFrom(msg.sender, text, sizeof(text))) {
+        display.setTextSize(1);
+        display.setCursor(0, 16);
+        display.print(text);
+        middleY = 24; // Keeps the timeline below the third line
+    } else {
+        display.setTextSize(2);
+        String msgStr = MessageMapping(msg.code);
+        display.getTextBounds(msgStr, 0, 0, &x1, &y1, &w, &h);
+        middleY = (display.height() - h) / 2;
+        display.setCursor((display.width() - w) / 2, middleY);
+        display.print(msgStr);
+    }
 
-    // (Time display moved to top right)
+    // Below: this hiker's earlier entries, newest first
+    const InboxRecord* history[INBOX_HISTORY_LEN];
+    int historyCount = inbox.history(msg.sender, history, INBOX_HISTORY_LEN);
+    String timeline;
+    int shown = 0;
+    for (int i = 0; i < historyCount && shown < 2; ++i) {
+        if (history[i] == &msg) continue;
+        if (shown++ > 0) timeline += ", ";
+        timeline += String(MessageMapping(history[i]->code)) + " " + elapsedString(history[i]->receivedMin, now_min);
+    }
+    if (shown > 0) {
+        display.setTextSize(1);
+        display.getTextBounds(timeline, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, middleY + 18);
+        display.print(timeline);
+    }
 
     // Bottom: "Back" on left, ">" on right
     display.setTextSize(1);
@@ -128,10 +185,11 @@ static void showInbox() {
     display.setCursor(display.width() - w, bottomY);
     display.print(arrow);
 
-    display.display();
+    pushFrame();
 }
 
 static void showMsgSelect() {
+    PROFILE_SCOPE(PROF_SHOW_MSG_SELECT);
     display.clearDisplay();
 
     // Top: current user state (centered)
@@ -144,10 +202,26 @@ static void showMsgSelect() {
     display.setCursor((display.width() - w) / 2, 0);
     display.print(stateStr);
 
+    // Below: how many peers acknowledged our urgent state, directly and via relays
+    int seen, members;
+    bool seenActive = seenOwnCount(seen, members) && members > 0;
+    if (isUrgentCode(device.getUserState()) && (urgentPeerCount() > 0 || seenActive)) {
+        // "ack 10/11 seen 10/11" is 20 characters, 120 px at size 1 on the 128 px panel
+        String ackStr;
+        if (urgentPeerCount() > 0) ackStr = String("ack ") + String(urgentDeliveredCount()) + "/" + String(urgentPeerCount());
+        if (seenActive) {
+            if (ackStr.length() > 0) ackStr += " ";
+            ackStr += String("seen ") + String(seen) + "/" + String(members);
+        }
+        display.getTextBounds(ackStr, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, 10);
+        display.print(ackStr);
+    }
+
     // Middle: message option, highlight current (centered vertically)
     display.setTextSize(2);
     //String msgStr = String("< ") + MessageMapping(msgSelectIndex) + " >";
-    String msgStr = MessageMapping(msgSelectIndex);
+    String msgStr = msgSelectIndex < messageSelectableCount() ? MessageMapping(messageSelectableCode(msgSelectIndex)) : "Text";
     display.getTextBounds(msgStr, 0, 0, &x1, &y1, &w, &h);
     int middleY = (display.height() - h) / 2;
     display.setCursor((display.width() - w) / 2, middleY);
@@ -163,7 +237,7 @@ static void showMsgSelect() {
     display.setCursor(display.width() - w, bottomY);
     display.print(arrow);
 
-    display.display();
+    pushFrame();
 }
 
 // Pairing state is now managed by Device
@@ -182,6 +256,7 @@ static int kbCol = 4; // Start at col 4 (N)
 static uint8_t prevUserState = 0;
 
 static void showInitialsKeyboard() {
+    PROFILE_SCOPE(PROF_SHOW_INITIALS_KEYBOARD);
     display.clearDisplay();
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
@@ -218,15 +293,167 @@ static void showInitialsKeyboard() {
     // Restore default text color
     display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
 
-    display.display();
+    pushFrame();
+}
+
+// Free text keyboard: the common part of the ShortText alphabet, '<' deletes, '>' sends
+#define TEXT_KB_ROWS 4
+#define TEXT_KB_COLS 12
+static const char textKeyboard[TEXT_KB_ROWS][TEXT_KB_COLS + 1] = {
+    "ABCDEFGHIJKL",
+    "MNOPQRSTUVWX",
+    "YZ0123456789",
+    " .,?!-:/'&<>"
+};
+static char composeText[TEXT_MAX_CHARS + 1] = "";
+static int composeLen = 0;
+static int textRow = 0;
+static int textCol = 0;
+
+static void showTextKeyboard() {
+    PROFILE_SCOPE(PROF_SHOW_TEXT_KEYBOARD);
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+
+    // Top: the tail of the text so far and a cursor, over at most two lines
+    const int visible = 2 * 21 - 1;
+    display.setCursor(0, 0);
+    display.print(composeText + (composeLen > visible ? composeLen - visible : 0));
+    display.print('_');
+
+    // Keyboard rows; space is drawn as '_' so it can be seen when highlighted
+    int kbStartY = 20;
+    for (int row = 0; row < TEXT_KB_ROWS; ++row) {
+        int y = kbStartY + row * 11;
+        int x = 4;
+        for (int col = 0; col < TEXT_KB_COLS; ++col) {
+            if (row == textRow && col == textCol) {
+                display.setTextColor(SSD1306_BLACK, SSD1306_WHITE);
+            } else {
+                display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+            }
+            display.setCursor(x, y);
+            char keyChar = textKeyboard[row][col];
+            display.print(keyChar == ' ' ? '_' : keyChar);
+            x += 10;
+        }
+    }
+    display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+
+    pushFrame();
+}
+
+// Directed send: pick a peer, then a code that goes to that peer only
+static int routePeerIndex = 0; // Into the peer list, broadcast entry skipped
+static uint8_t routeMsgIndex = 0;
+static const char* routeStatus = nullptr; // Result of the last send, shown until the next one
+
+static void showRoutePeer() {
+    PROFILE_SCOPE(PROF_SHOW_ROUTE_PEER);
+    display.clearDisplay();
+    display.setTextColor(SSD1306_WHITE);
+    int16_t x1, y1; uint16_t w, h;
+
+    // Top: title (centered)
+    display.setTextSize(1);
+    String title = "Send to";
+    display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
+    display.setCursor((display.width() - w) / 2, 0);
+    display.print(title);
+
+    // Middle: peer initials, MAC below
+    const auto& peers = device.getPeerList();
+    if (peers.size() <= 1) {
+        display.setTextSize(2);
+        String none = "No peers";
+        display.getTextBounds(none, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, (display.height() - h) / 2);
+        display.print(none);
+    } else {
+        const auto& peer = peers[routePeerIndex + 1];
+        char name[INITIALS_LEN];
+        size_t len = strnlen(peer.initials, INITIALS_LEN - 1);
+        memcpy(name, peer.initials, len);
+        name[len] = '\0';
+        display.setTextSize(2);
+        display.getTextBounds(name, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, 16);
+        display.print(name);
+        char macStr[MAC_STRING_LEN];
+        macToString(peer.mac, macStr);
+        display.setTextSize(1);
+        display.getTextBounds(macStr, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, 36);
+        display.print(macStr);
+    }
+
+    // Bottom: "Back" on left, ">" on right
+    display.setTextSize(1);
+    int bottomY = display.height() - 10;
+    display.setCursor(0, bottomY);
+    display.print("Back");
+    String arrow = ">";
+    display.getTextBounds(arrow, 0, 0, &x1, &y1, &w, &h);
+    display.setCursor(display.width() - w, bottomY);
+    display.print(arrow);
+
+    pushFrame();
+}
+
+static void showRouteMsg() {
+    PROFILE_SCOPE(PROF_SHOW_ROUTE_MSG);
+    display.clearDisplay();
+    display.setTextColor(SSD1306_WHITE);
+    int16_t x1, y1; uint16_t w, h;
+
+    // Top: recipient, and the result of the last send below it
+    display.setTextSize(1);
+    const auto& peers = device.getPeerList();
+    char name[INITIALS_LEN] = "?";
+    if (routePeerIndex + 1 < (int)peers.size()) {
+        size_t len = strnlen(peers[routePeerIndex + 1].initials, INITIALS_LEN - 1);
+        memcpy(name, peers[routePeerIndex + 1].initials, len);
+        name[len] = '\0';
+    }
+    String title = String("To ") + name;
+    display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
+    display.setCursor((display.width() - w) / 2, 0);
+    display.print(title);
+    if (routeStatus) {
+        display.getTextBounds(routeStatus, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor((display.width() - w) / 2, 10);
+        display.print(routeStatus);
+    }
+
+    // Middle: message option (centered)
+    display.setTextSize(2);
+    String msgStr = MessageMapping(messageSelectableCode(routeMsgIndex));
+    display.getTextBounds(msgStr, 0, 0, &x1, &y1, &w, &h);
+    display.setCursor((display.width() - w) / 2, (display.height() - h) / 2);
+    display.print(msgStr);
+
+    // Bottom: "Back" on left, ">" on right
+    display.setTextSize(1);
+    int bottomY = display.height() - 10;
+    display.setCursor(0, bottomY);
+    display.print("Back");
+    String arrow = ">";
+    display.getTextBounds(arrow, 0, 0, &x1, &y1, &w, &h);
+    display.setCursor(display.width() - w, bottomY);
+    display.print(arrow);
+
+    pushFrame();
 }
 
 static void showPairingMode() {
+    PROFILE_SCOPE(PROF_SHOW_PAIRING_MODE);
     display.clearDisplay();
     // Top: own MAC
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
-    String macStr = macToString_Arduino(device.getMACAddress(), MAC_SIZE);
+    char macStr[MAC_STRING_LEN];
+    macToString(device.getMACAddress(), macStr);
     int16_t x1, y1; uint16_t w, h;
     display.getTextBounds(macStr, 0, 0, &x1, &y1, &w, &h);
     display.setCursor((display.width() - w) / 2, 0);
@@ -246,15 +473,17 @@ static void showPairingMode() {
     display.setCursor(0, bottomY);
     display.print("Back");
 
-    display.display();
+    pushFrame();
 }
 
 static void showPairingRequest() {
+    PROFILE_SCOPE(PROF_SHOW_PAIRING_REQUEST);
     display.clearDisplay();
     // Top: own MAC
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
-    String macStr = macToString_Arduino(device.getMACAddress(), MAC_SIZE);
+    char macStr[MAC_STRING_LEN];
+    macToString(device.getMACAddress(), macStr);
     int16_t x1, y1; uint16_t w, h;
     display.getTextBounds(macStr, 0, 0, &x1, &y1, &w, &h);
     display.setCursor((display.width() - w) / 2, 0);
@@ -262,11 +491,10 @@ static void showPairingRequest() {
 
     // Middle: Requesting device MAC
     display.setTextSize(1);
-    String middle;
+    char pendingStr[MAC_STRING_LEN];
+    const char* middle = "No Request";
     if (device.hasPendingPairMAC()) {
-        middle = macToString_Arduino(device.getPendingPairMAC());
-    } else {
-        middle = "No Request";
+        middle = macToString(device.getPendingPairMAC(), pendingStr);
     }
     display.getTextBounds(middle, 0, 0, &x1, &y1, &w, &h);
     int middleY = (display.height() - h) / 2;
@@ -293,12 +521,11 @@ static void showPairingRequest() {
     display.setCursor((display.width() - w) / 2, pairY);
     display.print(pairStr);
 
-    display.display();
+    pushFrame();
 }
 
-static bool pairingConfirmed = false; // Add this flag
-
 static void showPairingConfirmed() {
+    PROFILE_SCOPE(PROF_SHOW_PAIRING_CONFIRMED);
     display.clearDisplay();
     display.setTextSize(2);
     display.setTextColor(SSD1306_WHITE);
@@ -307,13 +534,13 @@ static void showPairingConfirmed() {
     display.getTextBounds(msg, 0, 0, &x1, &y1, &w, &h);
     display.setCursor((display.width() - w) / 2, (display.height() - h) / 2);
     display.print(msg);
-    display.display();
-    initials[0] = '_'; initials[1] = '_'; initials[2] = '\0';
+    pushFrame();
 }
 
 static int peerListIndex = 0; // For navigating peer list
 
 static void showPeerList() {
+    PROFILE_SCOPE(PROF_SHOW_PEER_LIST);
     display.clearDisplay();
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
@@ -332,9 +559,12 @@ static void showPeerList() {
 
     for (int idx = pageStart; idx < pageEnd; ++idx) {
         int i = idx + 1; // skip index 0 (broadcast)
-        String ini = String(peers[i].initials.c_str());
-        String mac = macToString_Arduino(peers[i].mac, MAC_SIZE);
-        String line = ini + ": " + mac;
+        char line[INITIALS_LEN + 2 + MAC_STRING_LEN];
+        size_t len = strnlen(peers[i].initials, INITIALS_LEN - 1);
+        memcpy(line, peers[i].initials, len);
+        line[len] = ':';
+        line[len + 1] = ' ';
+        macToString(peers[i].mac, line + len + 2);
         display.getTextBounds(line, 0, 0, &x1, &y1, &w, &h);
         display.setCursor(0, y);
         if (idx == peerListIndex) {
@@ -356,229 +586,379 @@ static void showPeerList() {
 
     display.setTextColor(SSD1306_WHITE, SSD1306_BLACK); // Restore
 
-    display.display();
+    pushFrame();
 }
 
-void menuSetup() {
-    showMainMenu();
-    device.clearPendingPairMAC();
-    device.clearDeclinedPairMACs();
+static void resetInitials() {
     initials[0] = '_'; initials[1] = '_'; initials[2] = '\0';
     keyboardPos = 0;
     kbRow = 1; kbCol = 4; // Start at 'N'
+}
+
+// ---- Transition guards and actions ----
+
+static bool inboxNotEmpty() { return !device.getInbox().empty(); }
+static bool menuItemInbox() { return menuIndex == 0; }
+static bool menuItemSend() { return menuIndex == 1; }
+static bool menuItemPairing() { return menuIndex == 2; }
+static bool menuItemPeers() { return menuIndex == 3; }
+static bool menuItemDirect() { return menuIndex == 4; }
+static bool hasPendingPair() { return device.hasPendingPairMAC(); }
+static bool noPendingPair() { return !device.hasPendingPairMAC(); }
+static bool keyCompletesInitials() {
+    return keyboardPos == 1 && keyboard[kbRow][kbCol] != '<';
+}
+static int peerCount() {
+    // Skip the first peer (assumed to be broadcast)
+    const auto& peers = device.getPeerList();
+    return peers.size() > 1 ? peers.size() - 1 : 0;
+}
+static bool msgTextSelected() { return msgSelectIndex == messageSelectableCount(); }
+static bool textKeySend() { return textKeyboard[textRow][textCol] == '>'; }
+static bool textDeleteOnEmpty() { return textKeyboard[textRow][textCol] == '<' && composeLen == 0; }
+static bool routeHasPeers() { return peerCount() > 0; }
+// The chosen peer was removed meanwhile
+static bool routePeerGone() { return routePeerIndex >= peerCount(); }
+static bool routePickGone() { return routePeerIndex > 0 && routePeerGone(); }
+static bool peerClearAllSelected() { return peerListIndex == peerCount(); }
+static bool peerEntrySelected() { return peerListIndex < peerCount(); }
+
+static void mainNext() { menuIndex = (menuIndex + 1) % menuCount; }
+static void mainPrev() { menuIndex = (menuIndex - 1 + menuCount) % menuCount; }
+static void inboxToTop() { inboxSelValid = false; }
+static void inboxNext() { inboxSelect((inboxIndex() + 1) % device.getInbox().size()); }
+static void inboxPrev() {
+    int size = device.getInbox().size();
+    inboxSelect((inboxIndex() - 1 + size) % size);
+}
+static void msgNext() { msgSelectIndex = (msgSelectIndex + 1) % (messageSelectableCount() + 1); }
+static void msgSend() { device.setUserState(messageSelectableCode(msgSelectIndex)); }
+
+static void enterPairing() {
+    // Only set prevUserState and PAIRING_CODE if not already in pairing mode
+    if (device.getUserState() != PAIRING_CODE) {
+        prevUserState = device.getUserState();
+        device.setUserState(PAIRING_CODE);
+    }
+}
+static void exitPairing() {
+    // Reset pairing state
+    device.clearPendingPairMAC();
+    device.clearDeclinedPairMACs();
+    resetInitials();
+    // Restore user state to previous (only if currently PAIRING_CODE)
+    if (device.getUserState() == PAIRING_CODE) {
+        device.setUserState(prevUserState);
+    }
+}
+static void declinePair() {
+    // Decline: add to declined list, clear pending, return to pairing mode
+    if (device.hasPendingPairMAC()) {
+        device.addDeclinedPairMAC(device.getPendingPairMAC());
+        device.clearPendingPairMAC();
+    }
+}
+static void clearPendingPair() { device.clearPendingPairMAC(); }
+
+static void kbNextRow() { kbRow = (kbRow + 1) % 3; }
+static void kbNextCol() { kbCol = (kbCol + 1) % 9; }
+static void kbType() {
+    char selected = keyboard[kbRow][kbCol];
+    if (selected == '<') {
+        // Delete last character
+        if (keyboardPos > 0) {
+            --keyboardPos;
+            initials[keyboardPos] = '_';
+        }
+        return;
+    }
+    initials[0] = selected;
+    keyboardPos = 1;
+    kbRow = 1; kbCol = 4; // Reset to 'N'
+}
+static void kbConfirm() {
+    // Confirm initials, add to peer list
+    initials[1] = keyboard[kbRow][kbCol];
+    std::array<uint8_t, MAC_SIZE> mac = device.getPendingPairMAC();
+    device.addPeer(mac.data(), initials);
+    keyboardPos = 0;
+    kbRow = 1; kbCol = 4; // Reset to 'N'
+    device.clearPendingPairMAC();
+}
+
+static void textReset() {
+    composeText[0] = '\0';
+    composeLen = 0;
+    textRow = 0; textCol = 0;
+}
+static void textNextRow() { textRow = (textRow + 1) % TEXT_KB_ROWS; }
+static void textNextCol() { textCol = (textCol + 1) % TEXT_KB_COLS; }
+static void textType() {
+    char selected = textKeyboard[textRow][textCol];
+    if (selected == '<') {
+        if (composeLen > 0) composeText[--composeLen] = '\0';
+        return;
+    }
+    if (composeLen >= TEXT_MAX_CHARS) return;
+    composeText[composeLen++] = selected;
+    composeText[composeLen] = '\0';
+    // Refuse the character if the text no longer packs into one record
+    uint8_t symbols[TEXT_MAX_SYMBOLS];
+    if (textEncode(composeText, symbols, TEXT_MAX_SYMBOLS) < 0) composeText[--composeLen] = '\0';
+}
+// An empty text clears ours, as "text -" does on the console
+static void textSend() { shortTextCompose(composeText); }
+
+static void routeReset() {
+    routePeerIndex = 0;
+    routeMsgIndex = 0;
+    routeStatus = nullptr;
+}
+static void routeMsgEnter() {
+    routeMsgIndex = 0;
+    routeStatus = nullptr;
+}
+static void routePeerNext() { routePeerIndex = (routePeerIndex + 1) % peerCount(); }
+static void routeMsgNext() { routeMsgIndex = (routeMsgIndex + 1) % messageSelectableCount(); }
+static void routeMsgSend() {
+    const auto& peers = device.getPeerList();
+    if (routePeerIndex + 1 >= (int)peers.size()) return;
+    bool queued = routeSend(peers[routePeerIndex + 1].mac, messageSelectableCode(routeMsgIndex));
+    routeStatus = queued ? "Queued" : "Queue full";
+}
+
+static void peerNext() { peerListIndex = (peerListIndex + 1) % (peerCount() + 1); }
+static void peerResetIndex() { peerListIndex = 0; }
+static void peerClearAll() {
+    device.clearPeerList();
+    peerListIndex = 0;
+}
+static void peerRemove() {
+    // Remove specific peer (indexing: +1 for broadcast)
+    device.removePeerByIndex(peerListIndex + 1);
+    // After removal, clamp index if needed
+    if (peerListIndex >= peerCount()) peerListIndex = 0;
+}
+
+// ---- Transition table ----
+
+enum MenuInput : uint8_t {
+    IN_LEFT,
+    IN_RIGHT,
+    IN_SLCT,
+    IN_AUTO // Taken without a button when its guard holds
+};
+
+#define STAY MENU_STATE_COUNT
+
+struct MenuTransition {
+    MenuState from;
+    MenuInput input;
+    bool (*guard)();  // nullptr: always taken
+    void (*action)(); // nullptr: no side effect
+    MenuState to;     // STAY keeps the current state
+};
+
+// First matching row wins, so guarded rows come before their fallbacks
+static const MenuTransition transitions[] = {
+    {MAIN_MENU,         IN_RIGHT, nullptr,               mainNext,         (MenuState)STAY},
+    {MAIN_MENU,         IN_LEFT,  nullptr,               mainPrev,         (MenuState)STAY},
+    {MAIN_MENU,         IN_SLCT,  menuItemInbox,         inboxToTop,       INBOX},
+    {MAIN_MENU,         IN_SLCT,  menuItemSend,          nullptr,          MSG_SELECT},
+    {MAIN_MENU,         IN_SLCT,  menuItemPairing,       enterPairing,     PAIRING_MODE},
+    {MAIN_MENU,         IN_SLCT,  menuItemPeers,         peerResetIndex,   PEER_LIST},
+    {MAIN_MENU,         IN_SLCT,  menuItemDirect,        routeReset,       ROUTE_PEER},
+
+    {INBOX,             IN_RIGHT, inboxNotEmpty,         inboxNext,        (MenuState)STAY},
+    {INBOX,             IN_LEFT,  nullptr,               nullptr,          MAIN_MENU},
+    {INBOX,             IN_SLCT,  inboxNotEmpty,         inboxPrev,        (MenuState)STAY},
+
+    {MSG_SELECT,        IN_RIGHT, nullptr,               msgNext,          (MenuState)STAY},
+    {MSG_SELECT,        IN_LEFT,  nullptr,               nullptr,          MAIN_MENU},
+    {MSG_SELECT,        IN_SLCT,  msgTextSelected,       textReset,        TEXT_KEYBOARD},
+    {MSG_SELECT,        IN_SLCT,  nullptr,               msgSend,          (MenuState)STAY},
+
+    {TEXT_KEYBOARD,     IN_LEFT,  nullptr,               textNextRow,      (MenuState)STAY},
+    {TEXT_KEYBOARD,     IN_RIGHT, nullptr,               textNextCol,      (MenuState)STAY},
+    {TEXT_KEYBOARD,     IN_SLCT,  textKeySend,           textSend,         MSG_SELECT},
+    // Delete with nothing left to delete leaves without sending
+    {TEXT_KEYBOARD,     IN_SLCT,  textDeleteOnEmpty,     nullptr,          MSG_SELECT},
+    {TEXT_KEYBOARD,     IN_SLCT,  nullptr,               textType,         (MenuState)STAY},
+
+    {PAIRING_MODE,      IN_LEFT,  nullptr,               exitPairing,      MAIN_MENU},
+    {PAIRING_MODE,      IN_AUTO,  hasPendingPair,        nullptr,          PAIRING_REQUEST},
+
+    {PAIRING_REQUEST,   IN_RIGHT, nullptr,               declinePair,      PAIRING_MODE},
+    {PAIRING_REQUEST,   IN_SLCT,  hasPendingPair,        resetInitials,    PAIRING_KEYBOARD},
+    {PAIRING_REQUEST,   IN_SLCT,  noPendingPair,         nullptr,          PAIRING_MODE},
+    {PAIRING_REQUEST,   IN_LEFT,  nullptr,               clearPendingPair, MAIN_MENU},
+
+    {PAIRING_KEYBOARD,  IN_LEFT,  nullptr,               kbNextRow,        (MenuState)STAY},
+    {PAIRING_KEYBOARD,  IN_RIGHT, nullptr,               kbNextCol,        (MenuState)STAY},
+    {PAIRING_KEYBOARD,  IN_SLCT,  keyCompletesInitials,  kbConfirm,        PAIRING_CONFIRMED},
+    {PAIRING_KEYBOARD,  IN_SLCT,  nullptr,               kbType,           (MenuState)STAY},
+
+    // Any button returns to pairing mode
+    {PAIRING_CONFIRMED, IN_LEFT,  nullptr,               resetInitials,    PAIRING_MODE},
+    {PAIRING_CONFIRMED, IN_RIGHT, nullptr,               resetInitials,    PAIRING_MODE},
+    {PAIRING_CONFIRMED, IN_SLCT,  nullptr,               resetInitials,    PAIRING_MODE},
+
+    {PEER_LIST,         IN_RIGHT, nullptr,               peerNext,         (MenuState)STAY},
+    // Left (up) returns to menu, does not iterate
+    {PEER_LIST,         IN_LEFT,  nullptr,               nullptr,          MAIN_MENU},
+    {PEER_LIST,         IN_SLCT,  peerClearAllSelected,  peerClearAll,     (MenuState)STAY},
+    {PEER_LIST,         IN_SLCT,  peerEntrySelected,     peerRemove,       (MenuState)STAY},
+
+    {ROUTE_PEER,        IN_RIGHT, routeHasPeers,         routePeerNext,    (MenuState)STAY},
+    {ROUTE_PEER,        IN_LEFT,  nullptr,               nullptr,          MAIN_MENU},
+    {ROUTE_PEER,        IN_SLCT,  routeHasPeers,         routeMsgEnter,    ROUTE_MSG},
+    {ROUTE_PEER,        IN_AUTO,  routePickGone,         routeReset,       (MenuState)STAY},
+
+    {ROUTE_MSG,         IN_RIGHT, nullptr,               routeMsgNext,     (MenuState)STAY},
+    {ROUTE_MSG,         IN_LEFT,  nullptr,               nullptr,          ROUTE_PEER},
+    {ROUTE_MSG,         IN_SLCT,  nullptr,               routeMsgSend,     (MenuState)STAY},
+    {ROUTE_MSG,         IN_AUTO,  routePeerGone,         routeReset,       ROUTE_PEER},
+};
+static const int transitionCount = sizeof(transitions) / sizeof(transitions[0]);
+
+// One renderer per state, indexed by MenuState
+static void (*const renderers[MENU_STATE_COUNT])() = {
+    showMainMenu,         // MAIN_MENU
+    showInbox,            // INBOX
+    showMsgSelect,        // MSG_SELECT
+    showPairingMode,      // PAIRING_MODE
+    showPairingRequest,   // PAIRING_REQUEST
+    showInitialsKeyboard, // PAIRING_KEYBOARD
+    showPeerList,         // PEER_LIST
+    showPairingConfirmed, // PAIRING_CONFIRMED
+    showTextKeyboard,     // TEXT_KEYBOARD
+    showRoutePeer,        // ROUTE_PEER
+    showRouteMsg,         // ROUTE_MSG
+};
+
+// ---- Change watchers ----
+// Each returns a stamp of everything its screen shows; a changed stamp means redraw.
+
+static uint32_t stampMix(uint32_t a, uint32_t b) { return a * 31 + b; }
+
+static uint32_t watchInbox() {
+    const Inbox& inbox = device.getInbox();
+    uint32_t stamp = inbox.getGeneration();
+    if (inbox.empty()) return stamp;
+    const InboxRecord& msg = inbox.byPriority(inboxIndex());
+    const InboxRecord* history[INBOX_HISTORY_LEN];
+    int n = inbox.history(msg.sender, history, INBOX_HISTORY_LEN);
+    stamp = stampMix(stamp, inbox.versionOf(msg));
+    for (int i = 0; i < n; ++i) {
+        stamp = stampMix(stamp, inbox.versionOf(*history[i]));
+    }
+    stamp = stampMix(stamp, shortTextGeneration());
+    // The "m ago" labels age every minute
+    return stampMix(stamp, millis() / 60000);
+}
+static uint32_t watchUserState() {
+    return stampMix(stampMix(device.getUserState(), urgentDeliveryGeneration()), seenGeneration());
+}
+static uint32_t watchPairing() { return device.getPairingGeneration(); }
+static uint32_t watchPeers() { return device.getPeersGeneration(); }
+
+// One watcher per state, indexed by MenuState; nullptr for static screens
+static uint32_t (*const watchers[MENU_STATE_COUNT])() = {
+    nullptr,        // MAIN_MENU
+    watchInbox,     // INBOX
+    watchUserState, // MSG_SELECT
+    nullptr,        // PAIRING_MODE
+    watchPairing,   // PAIRING_REQUEST
+    nullptr,        // PAIRING_KEYBOARD
+    watchPeers,     // PEER_LIST
+    nullptr,        // PAIRING_CONFIRMED
+    nullptr,        // TEXT_KEYBOARD
+    watchPeers,     // ROUTE_PEER
+    watchPeers,     // ROUTE_MSG
+};
+
+// ---- Render engine ----
+
+static bool screenDirty = false;
+static uint32_t lastFrameMs = 0;
+static bool inputPending = false; // A press is waiting for its frame
+static uint32_t inputEdgeUs = 0;  // Edge time of the oldest such press
+static uint32_t renderedStamp = 0; // Watcher stamp at the last frame
+static uint32_t seenInboxTouches = 0;
+
+static bool applyTransition(MenuInput input) {
+    for (int i = 0; i < transitionCount; ++i) {
+        const MenuTransition& t = transitions[i];
+        if (t.from != menuState || t.input != input) continue;
+        if (t.guard && !t.guard()) continue;
+        if (t.action) t.action();
+        if (t.to != (MenuState)STAY) menuState = t.to;
+        screenDirty = true;
+        return true;
+    }
+    return false;
+}
+
+static void renderFrame() {
+    uint32_t startUs = micros();
+    renderedStamp = watchers[menuState] ? watchers[menuState]() : 0;
+    renderers[menuState]();
+    uint32_t endUs = micros();
+    lastFrameMs = millis();
+    screenDirty = false;
+    metricInc(METRIC_UI_FRAMES);
+    if (endUs - startUs > MENU_FRAME_BUDGET_US) metricInc(METRIC_UI_FRAME_OVERRUNS);
+    if (inputPending) {
+        // Button edge to completed display flush
+        histogramRecord(HIST_UI_LATENCY_US, endUs - inputEdgeUs);
+        inputPending = false;
+    }
+}
+
+void menuSetup() {
+    device.clearPendingPairMAC();
+    device.clearDeclinedPairMACs();
+    resetInitials();
     prevUserState = 0;
     peerListIndex = 0;
+    menuState = MAIN_MENU;
+    renderFrame();
 }
 
 void menuLoop() {
-    switch (menuState) {
-        case MAIN_MENU:
-            if (isButtonClicked(RIGHT_BTN_PIN)) {
-                menuIndex = (menuIndex + 1) % menuCount;
-                showMainMenu();
-            } else if (isButtonClicked(LEFT_BTN_PIN)) {
-                menuIndex = (menuIndex - 1 + menuCount) % menuCount;
-                showMainMenu();
-            } else if (isButtonClicked(SLCT_BTN_PIN)) {
-                switch (menuIndex) {
-                    case 0:
-                        menuState = INBOX;
-                        showInbox();
-                        break;
-                    case 1:
-                        menuState = MSG_SELECT;
-                        showMsgSelect();
-                        break;
-                    case 2:
-                        // Only set prevUserState and PAIRING_CODE if not already in pairing mode
-                        if (device.getUserState() != PAIRING_CODE) {
-                            prevUserState = device.getUserState();
-                            device.setUserState(PAIRING_CODE);
-                        }
-                        menuState = PAIRING_MODE;
-                        showPairingMode();
-                        break;
-                    case 3:
-                        peerListIndex = 0;
-                        menuState = PEER_LIST;
-                        showPeerList();
-                        break;
-                }
-            }
-            break;
-        case INBOX: {
-            const auto& inbox = device.getInbox();
-            int inboxSize = inbox.size();
-            if (device.inboxUpdated){
-                showInbox();
-                device.inboxUpdated = false; // Reset update flag
-            }
-            if (isButtonClicked(RIGHT_BTN_PIN) && inboxSize > 0) {
-                inboxIndex = (inboxIndex + 1) % inboxSize;
-                showInbox();
-            } else if (isButtonClicked(LEFT_BTN_PIN)) {
-                menuState = MAIN_MENU;
-                showMainMenu();
-            } else if (isButtonClicked(SLCT_BTN_PIN) && inboxSize > 0) {
-                // Optionally, treat select as back
-                inboxIndex = (inboxIndex - 1) % inboxSize;
-                showInbox();
-            }
-            break;
-        }
-        case PAIRING_MODE:
-        {
-            // If a pending pair MAC appears, transition to pairing request
-            if (device.hasPendingPairMAC()) {
-                menuState = PAIRING_REQUEST;
-                showPairingRequest();
-                break;
-            }
-            // Normal pairing mode UI and controls
-            if (isButtonClicked(LEFT_BTN_PIN)) {
-                menuState = MAIN_MENU;
-                showMainMenu();
-                // Reset pairing state
-                device.clearPendingPairMAC();
-                device.clearDeclinedPairMACs();
-                initials[0] = '_'; initials[1] = '_'; initials[2] = '\0';
-                keyboardPos = 0;
-                kbRow = 1; kbCol = 4; // Reset to 'N'
-                // Restore user state to previous (only if currently PAIRING_CODE)
-                if (device.getUserState() == PAIRING_CODE) {
-                    device.setUserState(prevUserState);
-                }
-                break;
-            }
-            break;
-        }
-        case PAIRING_REQUEST:
-        {
-            // Handle pairing request acceptance or decline
-            if (isButtonClicked(RIGHT_BTN_PIN)) {
-                // Decline: add to declined list, clear pending, return to pairing mode
-                if (device.hasPendingPairMAC()) {
-                    device.addDeclinedPairMAC(device.getPendingPairMAC());
-                    device.clearPendingPairMAC();
-                }
-                menuState = PAIRING_MODE;
-                showPairingMode();
-            } else if (isButtonClicked(SLCT_BTN_PIN)) {
-                // Accept: transition to keyboard entry
-                if (device.hasPendingPairMAC()) {
-                    menuState = PAIRING_KEYBOARD;
-                    keyboardPos = 0;
-                    kbRow = 1; kbCol = 4; // Reset to 'N'
-                    initials[0] = '_'; initials[1] = '_'; initials[2] = '\0';
-                    showInitialsKeyboard();
-                } else {
-                    // No pending MAC, return to pairing mode
-                    menuState = PAIRING_MODE;
-                    showPairingMode();
-                }
-            } else if (isButtonClicked(LEFT_BTN_PIN)) {
-                // Optional: treat select as back to pairing mode
-                menuState = MAIN_MENU;
-                device.clearPendingPairMAC();
-                showMainMenu();
-            }
-            break;
-        }
-        case PAIRING_KEYBOARD:
-        {
-            if (pairingConfirmed) {
-                // Wait for any button, then return to pairing mode
-                if (isButtonClicked(LEFT_BTN_PIN) || isButtonClicked(RIGHT_BTN_PIN) || isButtonClicked(SLCT_BTN_PIN)) {
-                    pairingConfirmed = false;
-                    menuState = PAIRING_MODE;
-                    showPairingMode();
-                }
-                break;
-            }
-            // Keyboard navigation and input
-            if (isButtonClicked(LEFT_BTN_PIN)) {
-                // Move up a row (wrap)
-                kbRow = (kbRow + 1) % 3;
-                showInitialsKeyboard();
-            } else if (isButtonClicked(RIGHT_BTN_PIN)) {
-                // Move right a column (wrap)
-                kbCol = (kbCol + 1) % 9;
-                showInitialsKeyboard();
-            } else if (isButtonClicked(SLCT_BTN_PIN)) {
-                char selected = keyboard[kbRow][kbCol];
-                if (selected == '<') {
-                    // Delete last character
-                    if (keyboardPos > 0) {
-                        --keyboardPos;
-                        initials[keyboardPos] = '_';
-                    }
-                    showInitialsKeyboard();
-                } else {
-                    initials[keyboardPos] = selected;
-                    if (keyboardPos == 0) {
-                        keyboardPos = 1;
-                        kbRow = 1; kbCol = 4; // Reset to 'N'
-                        showInitialsKeyboard();
-                    } else {
-                        // Confirm initials, add to peer list
-                        {
-                            std::array<uint8_t, MAC_SIZE> mac = device.getPendingPairMAC();
-                            device.addPeer(mac.data(), String(initials).c_str());
-                        }
-                        keyboardPos = 0;
-                        kbRow = 1; kbCol = 4; // Reset to 'N'
-                        // Clear pending MAC
-                        device.clearPendingPairMAC();
-                        pairingConfirmed = true;
-                        showPairingConfirmed();
-                        // Wait for button press to return to pairing mode
-                    }
-                }
-            }
-            break;
-        }
-        case MSG_SELECT:
-            if (isButtonClicked(RIGHT_BTN_PIN)) {
-                msgSelectIndex = (msgSelectIndex + 1) % msgCount;
-                showMsgSelect();
-            } else if (isButtonClicked(LEFT_BTN_PIN)) {
-                menuState = MAIN_MENU;
-                showMainMenu();
-            } else if (isButtonClicked(SLCT_BTN_PIN)) {
-                device.setUserState(msgSelectIndex);
-                menuState = MSG_SELECT;
-                showMsgSelect();
-            }
-            break;
-        case PEER_LIST: {
-            const auto& peers = device.getPeerList();
-            // Skip the first peer (assumed to be broadcast)
-            int peerCount = peers.size() > 1 ? peers.size() - 1 : 0;
-            int totalItems = peerCount + 1; // +1 for "Clear All"
-            if (isButtonClicked(RIGHT_BTN_PIN)) {
-                peerListIndex = (peerListIndex + 1) % totalItems;
-                showPeerList();
-            } else if (isButtonClicked(LEFT_BTN_PIN)) {
-                // Left (up) returns to menu, does not iterate
-                menuState = MAIN_MENU;
-                showMainMenu();
-            } else if (isButtonClicked(SLCT_BTN_PIN)) {
-                if (peerListIndex == peerCount) {
-                    // "Clear All" selected
-                    device.clearPeerList();
-                    peerListIndex = 0;
-                    showPeerList();
-                } else if (peerListIndex < peerCount) {
-                    // Remove specific peer (indexing: +1 for broadcast)
-                    device.removePeerByIndex(peerListIndex + 1);
-                    // After removal, clamp index if needed
-                    const auto& peers = device.getPeerList();
-                    int newPeerCount = peers.size() > 1 ? peers.size() - 1 : 0;
-                    if (peerListIndex >= newPeerCount) peerListIndex = 0;
-                    showPeerList();
-                }
-            }
-            break;
+    // Drain every queued event so presses that arrived while drawing are not lost
+    ButtonEvent ev;
+    while (buttonGetEvent(ev)) {
+        if (ev.type != BUTTON_PRESS) continue;
+        MenuInput input = ev.pin == LEFT_BTN_PIN ? IN_LEFT
+                        : ev.pin == RIGHT_BTN_PIN ? IN_RIGHT : IN_SLCT;
+        if (applyTransition(input) && !inputPending) {
+            inputPending = true;
+            inputEdgeUs = ev.timeUs;
         }
     }
-}
\ No newline at end of file
+    // Data-driven transitions and redraws
+    while (applyTransition(IN_AUTO)) {}
+    if (watchers[menuState] && watchers[menuState]() != renderedStamp) {
+        screenDirty = true;
+    }
+    // Every inbox update used to force a redraw; count the ones we skip
+    uint32_t touches = device.getInboxTouches();
+    if (menuState == INBOX && touches != seenInboxTouches && !screenDirty) {
+        metricInc(METRIC_UI_REDRAWS_AVOIDED);
+    }
+    seenInboxTouches = touches;
+    // Coalesce changes into at most one frame per MENU_FRAME_INTERVAL_MS
+    if (screenDirty && millis() - lastFrameMs >= MENU_FRAME_INTERVAL_MS) {
+        renderFrame();
+    }
+}
+
+uint32_t menuMsUntilRedraw(uint32_t nowMs) {
+    if (screenDirty) {
+        uint32_t since = nowMs - lastFrameMs;
+        return since >= MENU_FRAME_INTERVAL_MS ? 0 : MENU_FRAME_INTERVAL_MS - since;
+    }
+    if (menuState != INBOX || device.getInbox().empty()) return 0xFFFFFFFFUL;
+    return 60000 - nowMs % 60000;
+}
@@ -1,4 +1,8 @@
 #pragma once
 
+#include <stdint.h>
+
 void menuSetup();
 void menuLoop();
+// Milliseconds until the current screen needs a time-based redraw, 0xFFFFFFFF if none
+uint32_t menuMsUntilRedraw(uint32_t nowMs);
@@ -12,6 +12,100 @@ struct MessageStruct {
     uint8_t code;
 };
 
-const char* MessageMapping(int code);
+enum MessageFlags : uint8_t {
+    MSG_URGENT = 1,     // Bypasses power saving and is delivered as fast as possible
+    MSG_SELECTABLE = 2, // Offered by the Send Msg menu
+    MSG_CONTROL = 4,    // In-band signalling: never shown in the inbox nor carried
+    MSG_BODY = 8,       // Followed by body slots in a state frame
+};
+
+// Every code the boards exchange, the one place its meaning is defined.
+// severity orders the inbox, higher first. priority decides which carried
+// record is evicted first, lower first. ttl_s is how long a carried record is
+// relayed after it was last heard.
+// X(code, id, name, severity, priority, ttl_s, flags)
+#define MESSAGE_CATALOG(X) \
+    X(0,  CODE_NEUTRAL,   "NEUTRAL",   0, 0, 900,  MSG_SELECTABLE) \
+    X(1,  CODE_WAIT,      "WAIT",      2, 2, 1800, MSG_SELECTABLE) \
+    X(2,  CODE_GO_ON,     "GO ON",     1, 1, 1800, MSG_SELECTABLE) \
+    X(3,  CODE_RETREAT,   "RETREAT",   2, 2, 1800, MSG_SELECTABLE) \
+    X(4,  CODE_INJURED,   "INJURED",   3, 3, 7200, MSG_SELECTABLE | MSG_URGENT) \
+    X(5,  CODE_LEFT,      "LEFT",      1, 1, 1800, MSG_SELECTABLE) \
+    X(6,  CODE_RIGHT,     "RIGHT",     1, 1, 1800, MSG_SELECTABLE) \
+    X(7,  CODE_SOS,       "SOS",       4, 3, 7200, MSG_SELECTABLE | MSG_URGENT) \
+    X(8,  CODE_GOODBYE,   "GOODBYE",   1, 1, 1800, 0) \
+    X(9,  CODE_CONFIRMED, "CONFIRMED", 1, 1, 1800, 0) \
+    /* Record addressed to one hiker; two body slots follow (see Route.h) */ \
+    X(95, DIRECT_CODE,    "",          1, 0, 0,    MSG_CONTROL | MSG_BODY) \
+    /* Seen-by bitmap for an urgent origin; one body slot follows (see SeenMap.h) */ \
+    X(96, SEEN_CODE,      "",          1, 0, 0,    MSG_CONTROL | MSG_BODY) \
+    /* Short free-text record; its body follows in extra slots (see ShortText.h) */ \
+    X(97, TEXT_CODE,      "TEXT",      1, 0, 0,    MSG_BODY) \
+    /* Duty-cycle schedule root as its sender */ \
+    X(98, SYNC_CODE,      "",          1, 0, 0,    MSG_CONTROL) \
+    /* Our state while the pairing screen is open */ \
+    X(99, PAIRING_CODE,   "",          1, 0, 0,    MSG_CONTROL)
+
+#define MESSAGE_CODE_ENUM(code, id, name, severity, priority, ttl_s, flags) id = code,
+enum MessageCode : uint8_t { MESSAGE_CATALOG(MESSAGE_CODE_ENUM) };
+#undef MESSAGE_CODE_ENUM
+
+struct MessageInfo {
+    uint8_t code;
+    const char* name;
+    uint8_t severity;
+    uint8_t priority;
+    uint16_t ttlS;
+    uint8_t flags;
+};
+
+// The catalog, then what codes outside it (from newer firmware) are treated as
+#define MESSAGE_INFO_ENTRY(code, id, name, severity, priority, ttl_s, flags) \
+    {code, name, severity, priority, ttl_s, flags},
+inline constexpr MessageInfo MESSAGE_INFO[] = {MESSAGE_CATALOG(MESSAGE_INFO_ENTRY){0, "", 1, 1, 1800, 0}};
+#undef MESSAGE_INFO_ENTRY
+inline constexpr int MESSAGE_INFO_COUNT = sizeof(MESSAGE_INFO) / sizeof(MESSAGE_INFO[0]) - 1;
+
+constexpr bool messageCodesUnique() {
+    for (int i = 0; i < MESSAGE_INFO_COUNT; ++i) {
+        for (int j = i + 1; j < MESSAGE_INFO_COUNT; ++j) {
+            if (MESSAGE_INFO[i].code == MESSAGE_INFO[j].code) return false;
+        }
+    }
+    return true;
+}
+static_assert(messageCodesUnique(), "two message catalog entries share a code");
+
+// Code to catalog entry in one load, built at compile time
+struct MessageIndex {
+    uint8_t entry[256];
+    uint8_t selectable[MESSAGE_INFO_COUNT]; // Codes for the Send Msg menu, in catalog order
+    uint8_t selectableCount;
+};
+
+constexpr MessageIndex buildMessageIndex() {
+    MessageIndex index{};
+    for (int code = 0; code < 256; ++code) index.entry[code] = MESSAGE_INFO_COUNT;
+    for (int i = 0; i < MESSAGE_INFO_COUNT; ++i) {
+        index.entry[MESSAGE_INFO[i].code] = (uint8_t)i;
+        if (MESSAGE_INFO[i].flags & MSG_SELECTABLE) index.selectable[index.selectableCount++] = MESSAGE_INFO[i].code;
+    }
+    return index;
+}
+inline constexpr MessageIndex MESSAGE_INDEX = buildMessageIndex();
+
+constexpr const MessageInfo& messageInfo(uint8_t code) { return MESSAGE_INFO[MESSAGE_INDEX.entry[code]]; }
+constexpr const char* MessageMapping(int code) { return messageInfo((uint8_t)code).name; }
+// Inbox ordering rank: higher is more urgent
+constexpr uint8_t MessageSeverity(uint8_t code) { return messageInfo(code).severity; }
+// SOS and INJURED: bypass power saving and are delivered as fast as possible
+constexpr bool isUrgentCode(uint8_t code) { return (messageInfo(code).flags & MSG_URGENT) != 0; }
+constexpr bool isControlCode(uint8_t code) { return (messageInfo(code).flags & MSG_CONTROL) != 0; }
+constexpr uint8_t messageRelayPriority(uint8_t code) { return messageInfo(code).priority; }
+constexpr uint32_t messageRelayTtlMs(uint8_t code) { return messageInfo(code).ttlS * 1000UL; }
+constexpr int messageSelectableCount() { return MESSAGE_INDEX.selectableCount; }
+constexpr uint8_t messageSelectableCode(int i) { return MESSAGE_INDEX.selectable[i]; }
+
+static_assert(isUrgentCode(CODE_SOS) && !isUrgentCode(CODE_NEUTRAL), "catalog lookups fold at compile time");
 
-#endif // MESSAGE_H
\ No newline at end of file
+#endif // MESSAGE_H
@@ -0,0 +1,26 @@
+#include "Metrics.h"
+
+std::atomic<uint32_t> metricValues[METRIC_COUNT];
+std::atomic<uint32_t> histogramBuckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKETS];
+
+#define METRIC_NAME(id, name, kind) name,
+static const char* const metricNames[METRIC_COUNT] = { METRIC_LIST(METRIC_NAME) };
+#undef METRIC_NAME
+#define HISTOGRAM_NAME(id, name) name,
+static const char* const histogramNames[HISTOGRAM_COUNT] = { HISTOGRAM_LIST(HISTOGRAM_NAME) };
+#undef HISTOGRAM_NAME
+
+void metricsPrint(Print& out) {
+    out.printf("{\"uptime_ms\":%lu", (unsigned long)millis());
+    for (int i = 0; i < METRIC_COUNT; ++i) {
+        out.printf(",\"%s\":%lu", metricNames[i], (unsigned long)metricGet((MetricId)i));
+    }
+    for (int h = 0; h < HISTOGRAM_COUNT; ++h) {
+        out.printf(",\"%s\":[", histogramNames[h]);
+        for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            out.printf(b ? ",%lu" : "%lu", (unsigned long)histogramBuckets[h][b].load(std::memory_order_relaxed));
+        }
+        out.print("]");
+    }
+    out.println("}");
+}
@@ -0,0 +1,95 @@
+// Metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <atomic>
+
+// Counters only ever increase; gauges hold a current or peak value.
+// X(id, name, kind)
+#define METRIC_LIST(X) \
+    X(METRIC_FRAMES_SENT,          "frames_sent",          METRIC_COUNTER) \
+    X(METRIC_FRAMES_RECEIVED,      "frames_received",      METRIC_COUNTER) \
+    X(METRIC_PARSE_REJECTS,        "parse_rejects",        METRIC_COUNTER) \
+    X(METRIC_REJECT_SHORT,         "reject_short",         METRIC_COUNTER) \
+    X(METRIC_REJECT_MAGIC,         "reject_magic",         METRIC_COUNTER) \
+    X(METRIC_REJECT_VERSION,       "reject_version",       METRIC_COUNTER) \
+    X(METRIC_REJECT_GROUP,         "reject_group",         METRIC_COUNTER) \
+    X(METRIC_REJECT_CRC,           "reject_crc",           METRIC_COUNTER) \
+    X(METRIC_REJECT_TYPE,          "reject_type",          METRIC_COUNTER) \
+    X(METRIC_RX_THROTTLED,         "rx_throttled",         METRIC_COUNTER) \
+    X(METRIC_CARRY_EVICTIONS,      "carry_evictions",      METRIC_COUNTER) \
+    X(METRIC_CUSTODY_EVICTIONS,    "custody_evictions",    METRIC_COUNTER) \
+    X(METRIC_CUSTODY_DROPS,        "custody_drops",        METRIC_COUNTER) \
+    X(METRIC_NVS_COMMITS,          "nvs_commits",          METRIC_COUNTER) \
+    X(METRIC_SEND_FAILURES,        "send_failures",        METRIC_COUNTER) \
+    X(METRIC_PAIRING_SENT,         "pairing_sent",         METRIC_COUNTER) \
+    X(METRIC_PAIRING_RECEIVED,     "pairing_received",     METRIC_COUNTER) \
+    X(METRIC_ROSTER_SENT,          "roster_sent",          METRIC_COUNTER) \
+    X(METRIC_ROSTER_RECEIVED,      "roster_received",      METRIC_COUNTER) \
+    X(METRIC_TEXTS_SENT,           "texts_sent",           METRIC_COUNTER) \
+    X(METRIC_TEXTS_RECEIVED,       "texts_received",       METRIC_COUNTER) \
+    X(METRIC_DIRECT_SENT,          "direct_sent",          METRIC_COUNTER) \
+    X(METRIC_DIRECT_FORWARDED,     "direct_forwarded",     METRIC_COUNTER) \
+    X(METRIC_DIRECT_DELIVERED,     "direct_delivered",     METRIC_COUNTER) \
+    X(METRIC_DIRECT_SUPPRESSED,    "direct_suppressed",    METRIC_COUNTER) \
+    X(METRIC_TX_ENQUEUED,          "tx_enqueued",          METRIC_COUNTER) \
+    X(METRIC_TX_COALESCED,         "tx_coalesced",         METRIC_COUNTER) \
+    X(METRIC_TX_DROPPED,           "tx_dropped",           METRIC_COUNTER) \
+    X(METRIC_TX_DRIVER_ERRORS,     "tx_driver_errors",     METRIC_COUNTER) \
+    X(METRIC_TX_CREDIT_TIMEOUTS,   "tx_credit_timeouts",   METRIC_COUNTER) \
+    X(METRIC_BUTTON_DROPS,         "button_drops",         METRIC_COUNTER) \
+    X(METRIC_TRACE_DROPS,          "trace_drops",          METRIC_COUNTER) \
+    X(METRIC_GATEWAY_DROPS,        "gateway_drops",        METRIC_COUNTER) \
+    X(METRIC_UI_FRAMES,            "ui_frames",            METRIC_COUNTER) \
+    X(METRIC_UI_FRAME_OVERRUNS,    "ui_frame_overruns",    METRIC_COUNTER) \
+    X(METRIC_UI_REDRAWS_AVOIDED,   "ui_redraws_avoided",   METRIC_COUNTER) \
+    X(METRIC_TX_DEPTH,             "tx_depth",             METRIC_GAUGE) \
+    X(METRIC_TX_DEPTH_MAX,         "tx_depth_max",         METRIC_GAUGE) \
+    X(METRIC_LOOP_MAX_US,          "loop_max_us",          METRIC_GAUGE)
+
+// Power-of-two microsecond histograms: bucket 0 is < 2 us, bucket i is
+// [2^i, 2^(i+1)) us, the last bucket is open ended. X(id, name)
+#define HISTOGRAM_LIST(X) \
+    X(HIST_LOOP_US,       "loop_us") \
+    X(HIST_TX_LATENCY_US, "tx_latency_us") \
+    X(HIST_UI_LATENCY_US, "ui_latency_us")
+#define HISTOGRAM_BUCKETS 24
+
+enum MetricKind : uint8_t { METRIC_COUNTER, METRIC_GAUGE };
+
+#define METRIC_ENUM(id, name, kind) id,
+enum MetricId : uint8_t { METRIC_LIST(METRIC_ENUM) METRIC_COUNT };
+#undef METRIC_ENUM
+#define HISTOGRAM_ENUM(id, name) id,
+enum HistogramId : uint8_t { HISTOGRAM_LIST(HISTOGRAM_ENUM) HISTOGRAM_COUNT };
+#undef HISTOGRAM_ENUM
+
+extern std::atomic<uint32_t> metricValues[METRIC_COUNT];
+extern std::atomic<uint32_t> histogramBuckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKETS];
+
+// Safe from any task or ISR
+inline void metricInc(MetricId id, uint32_t n = 1) {
+    metricValues[id].fetch_add(n, std::memory_order_relaxed);
+}
+inline void metricSet(MetricId id, uint32_t v) {
+    metricValues[id].store(v, std::memory_order_relaxed);
+}
+inline void metricMax(MetricId id, uint32_t v) {
+    uint32_t cur = metricValues[id].load(std::memory_order_relaxed);
+    while (v > cur && !metricValues[id].compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+inline uint32_t metricGet(MetricId id) {
+    return metricValues[id].load(std::memory_order_relaxed);
+}
+inline void histogramRecord(HistogramId id, uint32_t us) {
+    int bucket = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+    histogramBuckets[id][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+// One JSON object per line: {"uptime_ms":..,"<metric>":..,"<histogram>":[..]}
+void metricsPrint(Print& out);
+
+#endif // METRICS_H
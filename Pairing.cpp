@@ -0,0 +1,121 @@
+#include <Arduino.h>
+#include "Pairing.h"
+#include "Communication.h"
+#include "Device.h"
+#include "TxQueue.h"
+#include "WireFrame.h"
+#include "Power.h"
+#include "Metrics.h"
+
+// Loop-side request schedule
+static bool active = false;
+static uint8_t requestSeq = 0;
+static uint32_t backoffMs = PAIRING_BACKOFF_MIN_MS;
+static uint32_t nextRequestMs = 0;
+
+// Responses owed, filled from the receive callback and sent from the loop
+static portMUX_TYPE pairingMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t replyTo[MAC_SIZE];
+static uint8_t replySeq = 0;
+static volatile bool replyPending = false;
+static volatile bool requestHeard = false; // Someone new is pairing: restart our backoff
+// Requesters already heard this session; only a new one restarts the backoff,
+// otherwise two boards would keep resetting each other
+static const int HEARD_MAX = 8;
+static uint8_t heard[HEARD_MAX][MAC_SIZE];
+static int heardCount = 0;
+
+static bool noteRequester(const uint8_t* mac) {
+    for (int i = 0; i < heardCount; ++i) {
+        if (memcmp(heard[i], mac, MAC_SIZE) == 0) return false;
+    }
+    if (heardCount < HEARD_MAX) memcpy(heard[heardCount++], mac, MAC_SIZE);
+    return true;
+}
+
+static void sendFrame(PairingFrameType type, uint8_t seq, const uint8_t* target) {
+    uint8_t frame[WIRE_HEADER_LEN + sizeof(PairingFrame)];
+    PairingFrame f;
+    f.type = type;
+    f.seq = seq;
+    memcpy(f.sender, device.getMACAddress(), MAC_SIZE);
+    memcpy(f.target, target, MAC_SIZE);
+    memcpy(frame + WIRE_HEADER_LEN, &f, sizeof(f));
+    int len = wireSeal(frame, WIRE_PAIRING, sizeof(f));
+    txEnqueue(broadcastAddress, frame, (uint16_t)len, TX_PRIO_NORMAL,
+              type == PAIR_REQUEST ? TX_KEY_PAIRING : TX_KEY_NONE);
+    metricInc(METRIC_PAIRING_SENT);
+}
+
+void pairingTick(uint32_t nowMs) {
+    bool pairing = device.getUserState() == PAIRING_CODE;
+    if (!pairing) {
+        active = false;
+        replyPending = false;
+        return;
+    }
+    if (!active) {
+        portENTER_CRITICAL(&pairingMux);
+        heardCount = 0;
+        portEXIT_CRITICAL(&pairingMux);
+    }
+    if (!active || requestHeard) {
+        // Entering the pairing screen, or a new board showed up: ask right away
+        active = true;
+        requestHeard = false;
+        backoffMs = PAIRING_BACKOFF_MIN_MS;
+        nextRequestMs = nowMs;
+    }
+    if (replyPending) {
+        uint8_t target[MAC_SIZE];
+        uint8_t seq;
+        portENTER_CRITICAL(&pairingMux);
+        memcpy(target, replyTo, MAC_SIZE);
+        seq = replySeq;
+        replyPending = false;
+        portEXIT_CRITICAL(&pairingMux);
+        sendFrame(PAIR_RESPONSE, seq, target);
+    }
+    if ((int32_t)(nowMs - nextRequestMs) >= 0) {
+        sendFrame(PAIR_REQUEST, requestSeq++, broadcastAddress);
+        nextRequestMs = nowMs + backoffMs;
+        backoffMs = min<uint32_t>(backoffMs * 2, PAIRING_BACKOFF_MAX_MS);
+    }
+}
+
+uint32_t pairingMsUntilNext(uint32_t nowMs) {
+    if (device.getUserState() != PAIRING_CODE) return POWER_NO_DEADLINE;
+    if (!active || replyPending || requestHeard) return 0;
+    int32_t left = (int32_t)(nextRequestMs - nowMs);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+void pairingOnFrame(const uint8_t* data, int len) {
+    if (len != (int)sizeof(PairingFrame)) {
+        metricInc(METRIC_PARSE_REJECTS);
+        return;
+    }
+    PairingFrame f;
+    memcpy(&f, data, sizeof(f));
+    metricInc(METRIC_PAIRING_RECEIVED);
+    if (device.getUserState() != PAIRING_CODE) return;
+    const uint8_t* self = device.getMACAddress();
+    if (memcmp(f.sender, self, MAC_SIZE) == 0) return;
+
+    MessageStruct msg;
+    memcpy(msg.sender, f.sender, MAC_SIZE);
+    msg.code = PAIRING_CODE;
+    if (f.type == PAIR_REQUEST) {
+        bool known = device.isPeer(f.sender);
+        device.checkPairingRequest(msg);
+        portENTER_CRITICAL(&pairingMux);
+        memcpy(replyTo, f.sender, MAC_SIZE);
+        replySeq = f.seq;
+        replyPending = true;
+        bool isNew = noteRequester(f.sender);
+        portEXIT_CRITICAL(&pairingMux);
+        if (!known && isNew) requestHeard = true;
+    } else if (f.type == PAIR_RESPONSE && memcmp(f.target, self, MAC_SIZE) == 0) {
+        device.checkPairingRequest(msg);
+    }
+}
@@ -0,0 +1,33 @@
+// Pairing.h
+#ifndef PAIRING_H
+#define PAIRING_H
+
+#include <stdint.h>
+
+// Pairing runs on its own small frame, separate from the state broadcast.
+// A board on the pairing screen broadcasts a request right away, then backs
+// off exponentially; any board on the pairing screen answers with a response
+// addressed to the requester, so both sides see each other after one exchange.
+#define PAIRING_BACKOFF_MIN_MS 100
+#define PAIRING_BACKOFF_MAX_MS 3200
+
+enum PairingFrameType : uint8_t {
+    PAIR_REQUEST = 1, // target is the broadcast address
+    PAIR_RESPONSE = 2 // target is the requester
+};
+
+// Body of a WIRE_PAIRING frame
+struct __attribute__((packed)) PairingFrame {
+    uint8_t type;   // PairingFrameType
+    uint8_t seq;    // Request counter, echoed in the response
+    uint8_t sender[6];
+    uint8_t target[6];
+};
+
+// Send requests with backoff while the user state is PAIRING_CODE; call from the loop
+void pairingTick(uint32_t nowMs);
+uint32_t pairingMsUntilNext(uint32_t nowMs);
+// Body of a received WIRE_PAIRING frame
+void pairingOnFrame(const uint8_t* data, int len);
+
+#endif // PAIRING_H
@@ -0,0 +1,86 @@
+#include "Power.h"
+#include "ButtonInput.h"
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+static TaskHandle_t loopTask = nullptr;
+static EnergyAccount account;
+static PowerState currentState = POWER_ACTIVE;
+static uint64_t stateSinceUs = 0;
+static bool radioOn = true;
+
+static void enterState(PowerState state) {
+    uint64_t now = esp_timer_get_time();
+    account.stateUs[currentState] += now - stateSinceUs;
+    stateSinceUs = now;
+    currentState = state;
+}
+
+void powerSetup() {
+    // setup() runs on the loop task, so this is the task to wake
+    loopTask = xTaskGetCurrentTaskHandle();
+    stateSinceUs = esp_timer_get_time();
+#ifdef USE_LIGHT_SLEEP
+    const int wakePins[] = {RIGHT_BTN_PIN, LEFT_BTN_PIN, SLCT_BTN_PIN};
+    for (int pin : wakePins) {
+        gpio_wakeup_enable((gpio_num_t)pin, GPIO_INTR_HIGH_LEVEL);
+    }
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_wifi_wakeup();
+#endif
+}
+
+void powerIdle(uint32_t waitMs) {
+    if (waitMs == 0) return;
+#ifdef USE_LIGHT_SLEEP
+    if (waitMs != POWER_NO_DEADLINE && waitMs >= LIGHT_SLEEP_MIN_MS) {
+        Serial.flush(); // UART stops while asleep
+        esp_sleep_enable_timer_wakeup((uint64_t)waitMs * 1000ULL);
+        enterState(POWER_LIGHT_SLEEP);
+        esp_light_sleep_start();
+        enterState(POWER_ACTIVE);
+        return;
+    }
+#endif
+    // Block on a task notification; the idle task clock-gates the CPU meanwhile
+    enterState(radioOn ? POWER_IDLE : POWER_RADIO_OFF);
+    ulTaskNotifyTake(pdTRUE, waitMs == POWER_NO_DEADLINE ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+    enterState(POWER_ACTIVE);
+}
+
+void powerWake() {
+    if (loopTask) xTaskNotifyGive(loopTask);
+}
+
+void IRAM_ATTR powerWakeFromISR() {
+    if (!loopTask) return;
+    BaseType_t higherPriorityWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(loopTask, &higherPriorityWoken);
+    portYIELD_FROM_ISR(higherPriorityWoken);
+}
+
+void powerSetRadioOn(bool on) {
+    radioOn = on;
+}
+
+void powerNoteTx(uint16_t payloadBytes) {
+    account.stateUs[POWER_TX] += energyAirtimeUs(payloadBytes);
+    account.txFrames++;
+}
+
+const EnergyAccount& powerGetAccount() {
+    enterState(currentState); // Bring the running state up to date
+    return account;
+}
+
+// One line of key=value pairs, readable by tools/battery_estimate
+void powerPrintReport(Print& out) {
+    const EnergyAccount& acc = powerGetAccount();
+    out.print("energy");
+    for (int s = 0; s < POWER_STATE_COUNT; ++s) {
+        out.printf(" %s_us=%llu", POWER_STATE_NAMES[s], (unsigned long long)acc.stateUs[s]);
+    }
+    double avgMa = energyAverageCurrentMa(acc);
+    out.printf(" tx_frames=%lu avg_ma=%.2f life_h=%.1f\n", (unsigned long)acc.txFrames, avgMa,
+               energyBatteryLifeHours(avgMa, BATTERY_CAPACITY_MAH));
+}
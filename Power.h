@@ -0,0 +1,30 @@
+// Power.h
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "EnergyModel.h"
+
+// Uncomment the next line to light-sleep between deadlines. The radio is
+// suspended while asleep, so frames from neighbours can be missed.
+//#define USE_LIGHT_SLEEP
+
+#define BATTERY_CAPACITY_MAH 2000
+#define POWER_NO_DEADLINE 0xFFFFFFFFUL
+#define LIGHT_SLEEP_MIN_MS 5 // Shorter waits are not worth the wakeup cost
+
+void powerSetup();
+// Block the loop task for up to waitMs, returning early on a wakeup
+void powerIdle(uint32_t waitMs);
+// Wake the loop task early (button edge, received frame, serial input)
+void powerWake();
+void IRAM_ATTR powerWakeFromISR();
+// Tell the accounting whether the radio is listening while idle
+void powerSetRadioOn(bool on);
+// Charge the airtime of one transmitted frame
+void powerNoteTx(uint16_t payloadBytes);
+const EnergyAccount& powerGetAccount();
+void powerPrintReport(Print& out);
+
+#endif // POWER_H
@@ -0,0 +1,78 @@
+#include "Profile.h"
+
+#ifdef USE_PROFILING
+
+#include <esp_cpu.h>
+#include <esp_timer.h>
+
+struct ProfileEntry {
+    uint32_t startUs;
+    uint32_t cycles;
+    uint8_t span;
+    uint8_t core;
+};
+
+static const char* const spanNames[] = {
+#define PROFILE_NAME(id, name) name,
+    PROFILE_SPAN_LIST(PROFILE_NAME)
+#undef PROFILE_NAME
+};
+
+static ProfileEntry ring[PROFILE_RING_LEN];
+static uint32_t recorded = 0; // Spans recorded since the last clear
+static bool paused = false;   // Set while a dump walks the ring
+static portMUX_TYPE profileMux = portMUX_INITIALIZER_UNLOCKED;
+
+ProfileScope::ProfileScope(ProfileSpan span)
+    : span(span), open(true), startUs((uint32_t)esp_timer_get_time()), startCycles(esp_cpu_get_cycle_count()) {}
+
+void profileRecord(ProfileSpan span, uint32_t startUs, uint32_t startCycles) {
+    // The cycle counter is per core, so the duration is only taken here on the same core
+    uint32_t cycles = esp_cpu_get_cycle_count() - startCycles;
+    uint8_t core = (uint8_t)xPortGetCoreID();
+    portENTER_CRITICAL_SAFE(&profileMux);
+    if (!paused) {
+        ProfileEntry& e = ring[recorded % PROFILE_RING_LEN];
+        e.startUs = startUs;
+        e.cycles = cycles;
+        e.span = span;
+        e.core = core;
+        recorded++;
+    }
+    portEXIT_CRITICAL_SAFE(&profileMux);
+}
+
+void profileDump(Print& out) {
+    portENTER_CRITICAL(&profileMux);
+    paused = true;
+    portEXIT_CRITICAL(&profileMux);
+
+    uint32_t mhz = getCpuFrequencyMhz();
+    out.print("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    out.print("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"core 0\"}},");
+    out.print("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"core 1\"}}");
+    uint32_t first = recorded > PROFILE_RING_LEN ? recorded - PROFILE_RING_LEN : 0;
+    for (uint32_t n = first; n < recorded; ++n) {
+        const ProfileEntry& e = ring[n % PROFILE_RING_LEN];
+        out.printf(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lu,\"dur\":%.3f}", spanNames[e.span],
+                   e.core, (unsigned long)e.startUs, (double)e.cycles / mhz);
+    }
+    out.println("]}");
+
+    portENTER_CRITICAL(&profileMux);
+    paused = false;
+    portEXIT_CRITICAL(&profileMux);
+}
+
+void profileClear() {
+    portENTER_CRITICAL(&profileMux);
+    recorded = 0;
+    portEXIT_CRITICAL(&profileMux);
+}
+
+#else
+
+void profileDump(Print& out) { out.println("profiling disabled, build with USE_PROFILING"); }
+void profileClear() {}
+
+#endif // USE_PROFILING
@@ -0,0 +1,79 @@
+// Profile.h
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Uncomment the next line to time the spans below into a RAM ring for the
+// "profile" console command. Costs PROFILE_RING_LEN * 12 bytes of RAM; with
+// it commented out every PROFILE_ macro compiles to nothing.
+//#define USE_PROFILING
+
+#define PROFILE_RING_LEN 256 // Most recent spans kept, oldest overwritten
+
+// X(id, name shown in the trace viewer)
+#define PROFILE_SPAN_LIST(X) \
+    X(PROF_LOOP,                   "loop") \
+    X(PROF_BROADCAST,              "broadcastMessages") \
+    X(PROF_PARSE,                  "ParseMessages") \
+    X(PROF_NVS_SAVE,               "saveToNVS") \
+    X(PROF_NVS_LOAD,               "loadFromNVS") \
+    X(PROF_SHOW_MAIN_MENU,         "showMainMenu") \
+    X(PROF_SHOW_INBOX,             "showInbox") \
+    X(PROF_SHOW_MSG_SELECT,        "showMsgSelect") \
+    X(PROF_SHOW_INITIALS_KEYBOARD, "showInitialsKeyboard") \
+    X(PROF_SHOW_PAIRING_MODE,      "showPairingMode") \
+    X(PROF_SHOW_PAIRING_REQUEST,   "showPairingRequest") \
+    X(PROF_SHOW_PAIRING_CONFIRMED, "showPairingConfirmed") \
+    X(PROF_SHOW_PEER_LIST,         "showPeerList") \
+    X(PROF_SHOW_TEXT_KEYBOARD,     "showTextKeyboard") \
+    X(PROF_SHOW_ROUTE_PEER,        "showRoutePeer") \
+    X(PROF_SHOW_ROUTE_MSG,         "showRouteMsg") \
+    X(PROF_DISPLAY_PUSH,           "display.display")
+
+#define PROFILE_ENUM(id, name) id,
+enum ProfileSpan : uint8_t { PROFILE_SPAN_LIST(PROFILE_ENUM) PROFILE_SPAN_COUNT };
+#undef PROFILE_ENUM
+
+// Write the ring as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// One row per core; durations come from the CPU cycle counter.
+void profileDump(Print& out);
+void profileClear();
+
+#ifdef USE_PROFILING
+
+// Record one finished span; safe from the radio callbacks
+void profileRecord(ProfileSpan span, uint32_t startUs, uint32_t startCycles);
+
+// Times the enclosing scope, or up to end()
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileSpan span);
+    ~ProfileScope() { end(); }
+    void end() {
+        if (open) profileRecord(span, startUs, startCycles);
+        open = false;
+    }
+private:
+    ProfileSpan span;
+    bool open;
+    uint32_t startUs;
+    uint32_t startCycles;
+};
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(span) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(span)
+#define PROFILE_SCOPE_NAMED(var, span) ProfileScope var(span)
+#define PROFILE_SCOPE_END(var) var.end()
+
+#else
+
+#define PROFILE_SCOPE(span) do {} while (0)
+#define PROFILE_SCOPE_NAMED(var, span) do {} while (0)
+#define PROFILE_SCOPE_END(var) do {} while (0)
+
+#endif // USE_PROFILING
+
+#endif // PROFILE_H
@@ -0,0 +1,387 @@
+#include "Roster.h"
+#include "Communication.h"
+#include "Device.h"
+#include "TxQueue.h"
+#include "WireFrame.h"
+#include "Power.h"
+#include "Metrics.h"
+#include "Utility.h"
+#include <nvs.h>
+
+static const char* NVS_NAMESPACE = "hiking";
+static const char* NVS_KEY_ROSTER = "roster";
+
+// One table serves both roles: our own roster when leader is our MAC, the
+// followed leader's roster otherwise. Stored in NVS as-is.
+struct __attribute__((packed)) RosterEntry {
+    uint8_t mac[MAC_SIZE];
+    char initials[2];
+    uint16_t version; // Leader version that last changed this entry
+    uint8_t removed;  // Tombstone, kept so deltas can carry the removal
+};
+
+struct __attribute__((packed)) RosterTable {
+    uint8_t leader[MAC_SIZE]; // All zero: no roster
+    uint16_t version;
+    uint16_t floor;           // Deltas from below this need a full snapshot
+    uint8_t count;
+    RosterEntry entries[ROSTER_MAX];
+};
+
+static RosterTable table;
+static uint8_t followedCount = 0;    // Size the followed leader last advertised
+static uint32_t lastLeaderHeardMs = 0;
+static uint32_t seenPeersGeneration = 0;
+static uint32_t lastChangeMs = 0;
+static uint32_t nextSummaryMs = 0;
+static uint32_t lastRequestMs = 0;
+static bool requestSent = false;
+static bool deltaOwed = false;
+static uint16_t deltaFrom = 0;
+
+// Frames from the receive callback, applied from the loop
+static const int INBOUND_SLOTS = 4;
+struct InboundFrame {
+    uint8_t len;
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+};
+static InboundFrame inbound[INBOUND_SLOTS];
+static_assert(sizeof(RosterFrameHeader) + ROSTER_MAX * sizeof(RosterWireEntry) <= WIRE_BODY_MAX,
+              "a full roster snapshot must fit one frame");
+static int inboundHead = 0;
+static int inboundCount = 0;
+static portMUX_TYPE rosterMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint8_t NO_MAC[MAC_SIZE] = {0};
+
+static bool macIs(const uint8_t* a, const uint8_t* b) { return memcmp(a, b, MAC_SIZE) == 0; }
+static bool leading() { return macIs(table.leader, device.getMACAddress()); }
+static bool following() { return !macIs(table.leader, NO_MAC) && !leading(); }
+
+static int liveCount() {
+    int n = 0;
+    for (int i = 0; i < table.count; ++i) {
+        if (!table.entries[i].removed) n++;
+    }
+    return n;
+}
+
+static RosterEntry* findEntry(const uint8_t* mac) {
+    for (int i = 0; i < table.count; ++i) {
+        if (macIs(table.entries[i].mac, mac)) return &table.entries[i];
+    }
+    return nullptr;
+}
+
+static void dropEntry(RosterEntry* e) {
+    *e = table.entries[--table.count];
+}
+
+// A free slot, evicting the oldest tombstone when full
+static RosterEntry* newEntry() {
+    if (table.count < ROSTER_MAX) return &table.entries[table.count++];
+    RosterEntry* oldest = nullptr;
+    for (int i = 0; i < table.count; ++i) {
+        RosterEntry& e = table.entries[i];
+        if (e.removed && (!oldest || e.version < oldest->version)) oldest = &e;
+    }
+    if (!oldest) return nullptr;
+    if (oldest->version > table.floor) table.floor = oldest->version;
+    return oldest;
+}
+
+static void saveTable() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    nvs_set_blob(handle, NVS_KEY_ROSTER, &table, sizeof(table));
+    if (nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+    nvs_close(handle);
+}
+
+void rosterSetup() {
+    memset(&table, 0, sizeof(table));
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
+    size_t len = sizeof(table);
+    if (nvs_get_blob(handle, NVS_KEY_ROSTER, &table, &len) != ESP_OK || len != sizeof(table) ||
+        table.count > ROSTER_MAX) {
+        memset(&table, 0, sizeof(table));
+    }
+    nvs_close(handle);
+    lastLeaderHeardMs = millis(); // Give a saved leader a full timeout to show up
+}
+
+// --- Peer list side ---
+
+static int peerIndex(const uint8_t* mac) {
+    const std::vector<Device::PeerInfo>& peers = device.getPeerList();
+    for (size_t i = 1; i < peers.size(); ++i) {
+        if (macIs(peers[i].mac, mac)) return (int)i;
+    }
+    return -1;
+}
+
+static void ensurePeer(const uint8_t* mac, const char* initials) {
+    if (macIs(mac, device.getMACAddress())) return;
+    char ini[INITIALS_LEN] = {initials[0], initials[1], '\0'};
+    int idx = peerIndex(mac);
+    if (idx >= 0) {
+        if (strcmp(device.getPeerList()[idx].initials, ini) == 0) return;
+        device.removePeerByIndex(idx); // Renamed by the leader
+    }
+    device.addPeer(mac, ini);
+}
+
+static void removePeer(const uint8_t* mac) {
+    int idx = peerIndex(mac);
+    if (idx >= 0) device.removePeerByIndex(idx);
+}
+
+// --- Leader side ---
+
+static void markChanged(uint32_t nowMs) {
+    lastChangeMs = nowMs;
+    nextSummaryMs = nowMs;
+    saveTable();
+}
+
+// Bring our own roster in line with the peers paired on this board
+static void syncFromPeers(uint32_t nowMs) {
+    bool changed = false;
+    const std::vector<Device::PeerInfo>& peers = device.getPeerList();
+    for (size_t i = 1; i < peers.size(); ++i) {
+        const Device::PeerInfo& p = peers[i];
+        RosterEntry* e = findEntry(p.mac);
+        if (e && !e->removed && memcmp(e->initials, p.initials, 2) == 0) continue;
+        if (!e && !(e = newEntry())) continue; // Roster full
+        memcpy(e->mac, p.mac, MAC_SIZE);
+        memcpy(e->initials, p.initials, 2);
+        e->removed = 0;
+        e->version = ++table.version;
+        changed = true;
+    }
+    for (int i = 0; i < table.count; ++i) {
+        RosterEntry& e = table.entries[i];
+        if (e.removed || peerIndex(e.mac) >= 0) continue;
+        e.removed = 1;
+        e.version = ++table.version;
+        changed = true;
+    }
+    if (changed) markChanged(nowMs);
+}
+
+static void startLeading(uint32_t nowMs) {
+    memset(&table, 0, sizeof(table));
+    memcpy(table.leader, device.getMACAddress(), MAC_SIZE);
+    deltaOwed = false;
+    syncFromPeers(nowMs);
+    seenPeersGeneration = device.getPeersGeneration();
+}
+
+static void follow(const uint8_t* leader, uint8_t count, uint32_t nowMs) {
+    // Our own peers stay in peerList as local entries; only the new roster is tracked
+    memset(&table, 0, sizeof(table));
+    memcpy(table.leader, leader, MAC_SIZE);
+    followedCount = count;
+    lastLeaderHeardMs = nowMs;
+    requestSent = false;
+    deltaOwed = false;
+    saveTable();
+}
+
+static void sendFrame(RosterFrameType type, uint16_t version, uint16_t base, uint8_t count,
+                      const RosterWireEntry* entries) {
+    uint8_t frame[TX_FRAME_MAX];
+    uint8_t* buf = frame + WIRE_HEADER_LEN;
+    RosterFrameHeader h;
+    h.type = type;
+    memcpy(h.sender, device.getMACAddress(), MAC_SIZE);
+    memcpy(h.leader, table.leader, MAC_SIZE);
+    h.version = version;
+    h.base = base;
+    h.count = count;
+    size_t len = sizeof(h);
+    memcpy(buf, &h, sizeof(h));
+    if (type == ROSTER_DELTA) {
+        memcpy(buf + len, entries, count * sizeof(RosterWireEntry));
+        len += count * sizeof(RosterWireEntry);
+    }
+    len = wireSeal(frame, WIRE_ROSTER, len);
+    txEnqueue(broadcastAddress, frame, (uint16_t)len, TX_PRIO_NORMAL,
+              type == ROSTER_SUMMARY ? TX_KEY_ROSTER : TX_KEY_NONE);
+    metricInc(METRIC_ROSTER_SENT);
+}
+
+static void sendDelta() {
+    RosterWireEntry entries[ROSTER_MAX];
+    bool full = deltaFrom == 0 || deltaFrom < table.floor;
+    uint8_t n = 0;
+    for (int i = 0; i < table.count; ++i) {
+        const RosterEntry& e = table.entries[i];
+        if (full ? e.removed : e.version <= deltaFrom) continue;
+        entries[n].op = e.removed ? ROSTER_OP_REMOVE : ROSTER_OP_SET;
+        memcpy(entries[n].mac, e.mac, MAC_SIZE);
+        memcpy(entries[n].initials, e.initials, 2);
+        n++;
+    }
+    sendFrame(ROSTER_DELTA, table.version, full ? 0 : deltaFrom, n, entries);
+    deltaOwed = false;
+}
+
+// --- Follower side ---
+
+static void request(uint32_t nowMs) {
+    if (requestSent && nowMs - lastRequestMs < ROSTER_REQUEST_MIN_MS) return;
+    sendFrame(ROSTER_REQUEST, table.version, 0, 0, nullptr);
+    lastRequestMs = nowMs;
+    requestSent = true;
+}
+
+static void applyDelta(const RosterFrameHeader& h, const RosterWireEntry* entries) {
+    bool full = h.base == 0;
+    if (!full && (h.base > table.version || h.version <= table.version)) return;
+    if (full) {
+        for (int i = 0; i < table.count; ++i) table.entries[i].removed = 1; // Unseen so far
+    }
+    for (int i = 0; i < h.count; ++i) {
+        const RosterWireEntry& w = entries[i];
+        RosterEntry* e = findEntry(w.mac);
+        if (w.op == ROSTER_OP_REMOVE) {
+            if (e) dropEntry(e);
+            removePeer(w.mac);
+            continue;
+        }
+        if (!e && !(e = newEntry())) continue;
+        memcpy(e->mac, w.mac, MAC_SIZE);
+        memcpy(e->initials, w.initials, 2);
+        e->version = h.version;
+        e->removed = 0;
+        ensurePeer(w.mac, w.initials);
+    }
+    if (full) {
+        // Entries missing from a snapshot left the roster
+        for (int i = table.count - 1; i >= 0; --i) {
+            if (!table.entries[i].removed) continue;
+            removePeer(table.entries[i].mac);
+            dropEntry(&table.entries[i]);
+        }
+    }
+    table.version = h.version;
+    saveTable();
+}
+
+static void handleFrame(const uint8_t* data, int len, uint32_t nowMs) {
+    RosterFrameHeader h;
+    memcpy(&h, data, sizeof(h));
+    const uint8_t* self = device.getMACAddress();
+    if (macIs(h.sender, self)) return;
+
+    if (h.type == ROSTER_SUMMARY) {
+        if (!device.isPeer(h.sender) || !macIs(h.sender, h.leader)) return;
+        if (following() && macIs(h.leader, table.leader)) {
+            lastLeaderHeardMs = nowMs;
+            followedCount = h.count;
+        } else {
+            // Follow the largest roster among our peers, lower MAC on a tie
+            int ourCount = leading() ? liveCount() : following() ? followedCount : -1;
+            const uint8_t* ourLeader = following() ? table.leader : self;
+            if (h.count < ourCount || (h.count == ourCount && memcmp(h.leader, ourLeader, MAC_SIZE) >= 0)) {
+                return;
+            }
+            follow(h.leader, h.count, nowMs);
+        }
+        if (h.version != table.version) request(nowMs);
+    } else if (h.type == ROSTER_REQUEST) {
+        if (!leading() || !macIs(h.leader, self)) return;
+        // One broadcast answers everyone behind; serve the oldest version asked for.
+        // A version ahead of ours is from before we restarted the roster.
+        uint16_t have = h.version > table.version ? 0 : h.version;
+        deltaFrom = deltaOwed ? min(deltaFrom, have) : have;
+        deltaOwed = true;
+    } else if (h.type == ROSTER_DELTA) {
+        if (!following() || !macIs(h.leader, table.leader)) return;
+        if (len < (int)(sizeof(h) + h.count * sizeof(RosterWireEntry))) return;
+        lastLeaderHeardMs = nowMs;
+        requestSent = false;
+        applyDelta(h, (const RosterWireEntry*)(data + sizeof(h)));
+    }
+}
+
+void rosterOnFrame(const uint8_t* data, int len) {
+    if (len < (int)sizeof(RosterFrameHeader)) {
+        metricInc(METRIC_PARSE_REJECTS);
+        return;
+    }
+    metricInc(METRIC_ROSTER_RECEIVED);
+    portENTER_CRITICAL(&rosterMux);
+    if (inboundCount < INBOUND_SLOTS) {
+        InboundFrame& f = inbound[(inboundHead + inboundCount) % INBOUND_SLOTS];
+        f.len = (uint8_t)len;
+        memcpy(f.data, data, len);
+        inboundCount++;
+    }
+    portEXIT_CRITICAL(&rosterMux);
+}
+
+void rosterTick(uint32_t nowMs) {
+    for (;;) {
+        InboundFrame f;
+        portENTER_CRITICAL(&rosterMux);
+        bool have = inboundCount > 0;
+        if (have) {
+            f = inbound[inboundHead];
+            inboundHead = (inboundHead + 1) % INBOUND_SLOTS;
+            inboundCount--;
+        }
+        portEXIT_CRITICAL(&rosterMux);
+        if (!have) break;
+        handleFrame(f.data, f.len, nowMs);
+    }
+
+    if (following() && nowMs - lastLeaderHeardMs >= ROSTER_LEADER_TIMEOUT_MS) {
+        memset(&table, 0, sizeof(table)); // Leader gone; its entries stay as local peers
+        saveTable();
+    }
+    if (!following() && !leading() && device.getPeerList().size() > 1) {
+        startLeading(nowMs);
+    }
+    if (!leading()) return;
+
+    if (device.getPeersGeneration() != seenPeersGeneration) {
+        seenPeersGeneration = device.getPeersGeneration();
+        syncFromPeers(nowMs);
+    }
+    if (deltaOwed) sendDelta();
+    if (liveCount() > 0 && (int32_t)(nowMs - nextSummaryMs) >= 0) {
+        sendFrame(ROSTER_SUMMARY, table.version, table.floor, (uint8_t)liveCount(), nullptr);
+        bool fast = nowMs - lastChangeMs < ROSTER_FAST_PERIOD_MS;
+        nextSummaryMs = nowMs + (fast ? ROSTER_SUMMARY_FAST_MS : ROSTER_SUMMARY_SLOW_MS);
+    }
+}
+
+uint32_t rosterMsUntilNext(uint32_t nowMs) {
+    if (inboundCount > 0 || deltaOwed) return 0;
+    if (leading()) {
+        if (liveCount() == 0) return POWER_NO_DEADLINE;
+        int32_t left = (int32_t)(nextSummaryMs - nowMs);
+        return left > 0 ? (uint32_t)left : 0;
+    }
+    if (following()) {
+        uint32_t elapsed = nowMs - lastLeaderHeardMs;
+        return elapsed >= ROSTER_LEADER_TIMEOUT_MS ? 0 : ROSTER_LEADER_TIMEOUT_MS - elapsed;
+    }
+    return POWER_NO_DEADLINE;
+}
+
+void rosterPrintReport(Print& out) {
+    char leader[MAC_STRING_LEN];
+    const char* role = leading() ? "lead" : following() ? "follow" : "none";
+    out.printf("roster role=%s leader=%s version=%u floor=%u entries=%d\n", role,
+               macToString(table.leader, leader), table.version, table.floor, liveCount());
+    for (int i = 0; i < table.count; ++i) {
+        const RosterEntry& e = table.entries[i];
+        char mac[MAC_STRING_LEN];
+        out.printf("roster_entry mac=%s initials=%.2s version=%u removed=%u\n",
+                   macToString(e.mac, mac), e.initials, e.version, e.removed);
+    }
+}
@@ -0,0 +1,56 @@
+// Roster.h
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// Group roster sync: one board shares its peer list so the rest of the party
+// only has to pair with that board. A board leads a roster of the peers it
+// paired itself; when a peer advertises a larger roster (ties: lower MAC) the
+// board follows that one instead and merges its entries into peerList.
+//
+// Leaders send a small SUMMARY (version, size). A follower that is behind
+// sends a REQUEST with the version it has, and the leader answers with a
+// broadcast DELTA of the entries changed since then (or a full snapshot),
+// which every follower at or past its base version can apply.
+#define ROSTER_MAX 24                    // Live entries plus removal tombstones
+#define ROSTER_SUMMARY_FAST_MS 2000      // Summary interval right after a change
+#define ROSTER_SUMMARY_SLOW_MS 10000     // Summary interval once stable
+#define ROSTER_FAST_PERIOD_MS 60000      // How long a change keeps the fast interval
+#define ROSTER_REQUEST_MIN_MS 500        // Spacing between our requests
+#define ROSTER_LEADER_TIMEOUT_MS 60000   // A silent leader is dropped after this
+
+enum RosterFrameType : uint8_t {
+    ROSTER_SUMMARY = 1,
+    ROSTER_REQUEST = 2, // version = version the requester has, 0 for none
+    ROSTER_DELTA = 3    // version = resulting version, base = 0 for a full snapshot
+};
+
+// Body of a WIRE_ROSTER frame: this header, then count entries for a DELTA
+struct __attribute__((packed)) RosterFrameHeader {
+    uint8_t type;      // RosterFrameType
+    uint8_t sender[6];
+    uint8_t leader[6];
+    uint16_t version;
+    uint16_t base;
+    uint8_t count;     // SUMMARY: live entries, DELTA: entries that follow
+};
+
+enum RosterOp : uint8_t { ROSTER_OP_SET, ROSTER_OP_REMOVE };
+
+struct __attribute__((packed)) RosterWireEntry {
+    uint8_t op; // RosterOp
+    uint8_t mac[6];
+    char initials[2];
+};
+
+void rosterSetup();
+// Apply received roster frames and send summaries/requests/deltas; call from the loop
+void rosterTick(uint32_t nowMs);
+uint32_t rosterMsUntilNext(uint32_t nowMs);
+// Body of a received WIRE_ROSTER frame; queued for rosterTick
+void rosterOnFrame(const uint8_t* data, int len);
+void rosterPrintReport(Print& out);
+
+#endif // ROSTER_H
@@ -0,0 +1,229 @@
+#include "Route.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Metrics.h"
+#include "Utility.h"
+
+static_assert(DIRECT_BODY_LEN == 2 * (MAC_SIZE + 1), "the body is two record slots");
+static_assert(DIRECT_TTL <= 15, "the TTL shares its byte with the id");
+
+struct RouteEntry {
+    bool used;
+    uint8_t dest[MAC_SIZE];
+    uint8_t nextHop[MAC_SIZE];
+    uint8_t hops;
+    uint32_t heardMs;
+};
+
+struct DirectEntry {
+    bool used;
+    uint8_t origin[MAC_SIZE];
+    uint8_t dest[MAC_SIZE];
+    uint8_t code;
+    uint8_t nextHop[MAC_SIZE];
+    uint8_t idTtl;
+    uint8_t sendsLeft;
+};
+
+// Directed records already handled, so repeats and copies from other paths are dropped
+struct DirectSeen {
+    bool used;
+    uint8_t origin[MAC_SIZE];
+    uint8_t dest[MAC_SIZE];
+    uint8_t code;
+    uint8_t id;
+    uint32_t atMs;
+};
+
+static RouteEntry routes[ROUTE_TABLE_LEN];
+static DirectEntry queue[DIRECT_QUEUE_LEN];
+static DirectSeen seen[DIRECT_SEEN_LEN];
+static int seenNext = 0;
+static int rotation = 0;
+static uint8_t ownId = 0;
+static portMUX_TYPE routeMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool macIs(const uint8_t* a, const uint8_t* b) { return memcmp(a, b, MAC_SIZE) == 0; }
+
+// Called with routeMux held
+static RouteEntry* findRoute(const uint8_t* dest, uint32_t nowMs) {
+    for (int i = 0; i < ROUTE_TABLE_LEN; ++i) {
+        RouteEntry& r = routes[i];
+        if (!r.used || !macIs(r.dest, dest)) continue;
+        if (nowMs - r.heardMs >= ROUTE_TTL_MS) {
+            r.used = false;
+            return nullptr;
+        }
+        return &r;
+    }
+    return nullptr;
+}
+
+// Called with routeMux held
+static void learn(const uint8_t* dest, const uint8_t* nextHop, uint8_t hops, uint32_t nowMs) {
+    if (macIs(dest, device.getMACAddress())) return;
+    RouteEntry* r = findRoute(dest, nowMs);
+    if (r) {
+        // Keep a shorter route while it is fresh; the same neighbour always refreshes
+        bool better = hops < r->hops || macIs(nextHop, r->nextHop) || nowMs - r->heardMs >= ROUTE_STALE_MS;
+        if (!better) return;
+    } else {
+        // A free slot, else the route heard longest ago
+        r = &routes[0];
+        for (int i = 0; i < ROUTE_TABLE_LEN; ++i) {
+            if (!routes[i].used) {
+                r = &routes[i];
+                break;
+            }
+            if ((int32_t)(routes[i].heardMs - r->heardMs) < 0) r = &routes[i];
+        }
+        r->used = true;
+        memcpy(r->dest, dest, MAC_SIZE);
+    }
+    memcpy(r->nextHop, nextHop, MAC_SIZE);
+    r->hops = hops;
+    r->heardMs = nowMs;
+}
+
+void routeOnFrame(const MessageStruct* msgs, int count, uint32_t nowMs) {
+    portENTER_CRITICAL(&routeMux);
+    for (int i = 0; i < count; ++i) {
+        if (msgs[i].code == SYNC_CODE) continue; // Its sender is the schedule root, not a relayed state
+        learn(msgs[i].sender, msgs[0].sender, i == 0 ? 1 : 2, nowMs);
+    }
+    portEXIT_CRITICAL(&routeMux);
+}
+
+// Called with routeMux held; true if this record was handled before
+static bool seenBefore(const uint8_t* origin, const uint8_t* dest, uint8_t code, uint8_t id, uint32_t nowMs) {
+    for (int i = 0; i < DIRECT_SEEN_LEN; ++i) {
+        const DirectSeen& s = seen[i];
+        if (s.used && s.code == code && s.id == id && macIs(s.origin, origin) && macIs(s.dest, dest) &&
+            nowMs - s.atMs < DIRECT_SEEN_MS) {
+            return true;
+        }
+    }
+    DirectSeen& s = seen[seenNext];
+    seenNext = (seenNext + 1) % DIRECT_SEEN_LEN;
+    s.used = true;
+    memcpy(s.origin, origin, MAC_SIZE);
+    memcpy(s.dest, dest, MAC_SIZE);
+    s.code = code;
+    s.id = id;
+    s.atMs = nowMs;
+    return false;
+}
+
+// Called with routeMux held
+static bool enqueue(const uint8_t* origin, const uint8_t* dest, uint8_t code, uint8_t id, uint8_t ttl, uint32_t nowMs) {
+    DirectEntry* e = nullptr;
+    for (int i = 0; i < DIRECT_QUEUE_LEN && !e; ++i) {
+        if (!queue[i].used) e = &queue[i];
+    }
+    if (!e) return false;
+    RouteEntry* r = findRoute(dest, nowMs);
+    e->used = true;
+    memcpy(e->origin, origin, MAC_SIZE);
+    memcpy(e->dest, dest, MAC_SIZE);
+    e->code = code;
+    memcpy(e->nextHop, r ? r->nextHop : broadcastAddress, MAC_SIZE);
+    e->idTtl = (uint8_t)(id << 4 | ttl);
+    e->sendsLeft = DIRECT_REPEATS;
+    return true;
+}
+
+void routeOnRecord(const uint8_t* frameSender, const uint8_t* origin, const uint8_t* body) {
+    const uint8_t* dest = body;
+    uint8_t code = body[MAC_SIZE];
+    const uint8_t* nextHop = body + MAC_SIZE + 1;
+    uint8_t id = body[2 * MAC_SIZE + 1] >> 4;
+    uint8_t ttl = body[2 * MAC_SIZE + 1] & 0x0F;
+    const uint8_t* self = device.getMACAddress();
+    if (macIs(origin, self) || ttl == 0 || ttl > DIRECT_TTL) return;
+    uint32_t nowMs = millis();
+    bool deliver = false;
+    portENTER_CRITICAL(&routeMux);
+    // The record came the way back to its origin
+    learn(origin, frameSender, DIRECT_TTL - ttl + 1, nowMs);
+    bool forMe = macIs(dest, self);
+    bool onPath = macIs(nextHop, self) || macIs(nextHop, broadcastAddress);
+    if (!forMe && !onPath) {
+        metricInc(METRIC_DIRECT_SUPPRESSED);
+    } else if (!seenBefore(origin, dest, code, id, nowMs)) {
+        if (forMe) {
+            deliver = true;
+        } else if (ttl > 1 && enqueue(origin, dest, code, id, ttl - 1, nowMs)) {
+            metricInc(METRIC_DIRECT_FORWARDED);
+        }
+    }
+    portEXIT_CRITICAL(&routeMux);
+    if (deliver) {
+        MessageStruct msg;
+        memcpy(msg.sender, origin, MAC_SIZE);
+        msg.code = code;
+        device.addOrUpdateInboxIfPeer(msg);
+        metricInc(METRIC_DIRECT_DELIVERED);
+    }
+}
+
+bool routeSend(const uint8_t* dest, uint8_t code) {
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&routeMux);
+    ownId = (ownId + 1) & 0x0F;
+    bool queued = enqueue(device.getMACAddress(), dest, code, ownId, DIRECT_TTL, nowMs);
+    portEXIT_CRITICAL(&routeMux);
+    if (queued) metricInc(METRIC_DIRECT_SENT);
+    return queued;
+}
+
+int routeAppend(uint8_t* out, int room, uint32_t nowMs) {
+    const int recordBytes = MAC_SIZE + 1 + DIRECT_BODY_LEN;
+    int written = 0;
+    portENTER_CRITICAL(&routeMux);
+    int start = rotation;
+    for (int k = 0; k < DIRECT_QUEUE_LEN; ++k) {
+        int i = (start + k) % DIRECT_QUEUE_LEN;
+        DirectEntry& e = queue[i];
+        if (!e.used) continue;
+        if (written + recordBytes > room) {
+            rotation = i;
+            break;
+        }
+        // A route learned since queueing beats the flood fallback
+        if (macIs(e.nextHop, broadcastAddress)) {
+            RouteEntry* r = findRoute(e.dest, nowMs);
+            if (r) memcpy(e.nextHop, r->nextHop, MAC_SIZE);
+        }
+        uint8_t* rec = out + written;
+        memcpy(rec, e.origin, MAC_SIZE);
+        rec[MAC_SIZE] = DIRECT_CODE;
+        uint8_t* body = rec + MAC_SIZE + 1;
+        memcpy(body, e.dest, MAC_SIZE);
+        body[MAC_SIZE] = e.code;
+        memcpy(body + MAC_SIZE + 1, e.nextHop, MAC_SIZE);
+        body[2 * MAC_SIZE + 1] = e.idTtl;
+        written += recordBytes;
+        if (--e.sendsLeft == 0) e.used = false;
+        rotation = (i + 1) % DIRECT_QUEUE_LEN;
+    }
+    portEXIT_CRITICAL(&routeMux);
+    return written;
+}
+
+void routePrintReport(Print& out) {
+    uint32_t nowMs = millis();
+    for (int i = 0; i < ROUTE_TABLE_LEN; ++i) {
+        const RouteEntry& r = routes[i];
+        if (!r.used || nowMs - r.heardMs >= ROUTE_TTL_MS) continue;
+        char dest[MAC_STRING_LEN], hop[MAC_STRING_LEN];
+        out.printf("route dest=%s via=%s hops=%u age_s=%lu\n", macToString(r.dest, dest), macToString(r.nextHop, hop),
+                   r.hops, (unsigned long)((nowMs - r.heardMs) / 1000));
+    }
+    for (int i = 0; i < DIRECT_QUEUE_LEN; ++i) {
+        const DirectEntry& e = queue[i];
+        if (!e.used) continue;
+        char origin[MAC_STRING_LEN], dest[MAC_STRING_LEN];
+        out.printf("queued origin=%s dest=%s code=%s ttl=%u sends_left=%u\n", macToString(e.origin, origin),
+                   macToString(e.dest, dest), MessageMapping(e.code), e.idTtl & 0x0F, e.sendsLeft);
+    }
+}
@@ -0,0 +1,39 @@
+// Route.h
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "Message.h"
+
+// Records addressed to one hiker, forwarded hop by hop instead of flooded.
+// Routes are learned backwards from what we overhear: a state record from
+// origin O arriving in a frame sent by neighbour N means N can reach O, one
+// hop away when O is the sender itself and further when N relays it.
+//
+// A directed record is a normal 7-byte record {origin, DIRECT_CODE} followed
+// by two body slots: [destination MAC][code] and [next hop MAC][id << 4 | ttl].
+// Only the named next hop forwards it, choosing the next hop from its own
+// table. A next hop of FF:FF:FF:FF:FF:FF means the sender knew no route, and
+// every board that hears it may forward it once until the TTL runs out.
+#define ROUTE_TABLE_LEN 16
+#define ROUTE_TTL_MS (2UL * 60UL * 1000UL)  // Forget a route not confirmed this long
+#define ROUTE_STALE_MS (20UL * 1000UL)      // A longer route may replace one older than this
+#define DIRECT_BODY_LEN 14
+#define DIRECT_TTL 6                        // Hops, at most 15
+#define DIRECT_QUEUE_LEN 8                  // Our own and forwarded records waiting to go out
+#define DIRECT_REPEATS 3                    // Broadcasts each record rides along in
+#define DIRECT_SEEN_LEN 16
+#define DIRECT_SEEN_MS (60UL * 1000UL)      // Duplicate suppression window
+
+// Learn routes from the records of one received state frame; msgs[0] is the sender
+void routeOnFrame(const MessageStruct* msgs, int count, uint32_t nowMs);
+// Handle a directed record heard from frameSender; body is DIRECT_BODY_LEN bytes
+void routeOnRecord(const uint8_t* frameSender, const uint8_t* origin, const uint8_t* body);
+// Queue our own code for one hiker; false when the queue is full
+bool routeSend(const uint8_t* dest, uint8_t code);
+// Append queued directed records within room bytes; returns bytes written. Call once per broadcast.
+int routeAppend(uint8_t* out, int room, uint32_t nowMs);
+void routePrintReport(Print& out);
+
+#endif // ROUTE_H
@@ -0,0 +1,61 @@
+#include "RxLimit.h"
+#include <string.h>
+#include "Communication.h"
+#include "Message.h"
+#include "Metrics.h"
+
+// Tokens are kept in thousandths so refills need no division per frame
+static const uint32_t TOKEN = 1000;
+
+struct SenderBucket {
+    uint8_t mac[MAC_SIZE];
+    uint32_t tokens;
+    uint32_t lastMs;
+    bool used;
+};
+
+// Only touched from the receive callback
+static SenderBucket buckets[RX_LIMIT_SENDERS];
+
+static SenderBucket& bucketFor(const uint8_t* mac, uint32_t nowMs) {
+    SenderBucket* victim = nullptr;
+    for (int i = 0; i < RX_LIMIT_SENDERS; ++i) {
+        SenderBucket& b = buckets[i];
+        if (!b.used) {
+            if (!victim || victim->used) victim = &b;
+            continue;
+        }
+        if (memcmp(b.mac, mac, MAC_SIZE) == 0) return b;
+        if (!victim || (victim->used && nowMs - b.lastMs > nowMs - victim->lastMs)) victim = &b;
+    }
+    // A new sender starts with a full bucket
+    memcpy(victim->mac, mac, MAC_SIZE);
+    victim->tokens = RX_LIMIT_BURST * TOKEN;
+    victim->lastMs = nowMs;
+    victim->used = true;
+    return *victim;
+}
+
+// Only the sender's own record (slot 0) counts. Relayed urgent records ride
+// along in every neighbour's frames for as long as the episode lasts, so
+// exempting those would switch the limit off for the whole group.
+static bool senderUrgent(const uint8_t* body, int bodyLen) {
+    return bodyLen > MAC_SIZE && isUrgentCode(body[MAC_SIZE]);
+}
+
+bool rxAdmit(const uint8_t* mac, WireType type, const uint8_t* body, int bodyLen, uint32_t nowMs) {
+    if (type == WIRE_STATE && senderUrgent(body, bodyLen)) return true;
+    SenderBucket& b = bucketFor(mac, nowMs);
+    uint32_t elapsed = nowMs - b.lastMs;
+    b.lastMs = nowMs;
+    // Cap the elapsed time so the multiplication cannot overflow
+    if (elapsed > RX_LIMIT_BURST * 1000UL) elapsed = RX_LIMIT_BURST * 1000UL;
+    b.tokens += elapsed * RX_LIMIT_RATE_PER_S * TOKEN / 1000;
+    if (b.tokens > RX_LIMIT_BURST * TOKEN) b.tokens = RX_LIMIT_BURST * TOKEN;
+    if (b.tokens < TOKEN) {
+        metricInc(METRIC_RX_THROTTLED);
+        return false;
+    }
+    b.tokens -= TOKEN;
+    return true;
+}
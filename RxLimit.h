@@ -0,0 +1,21 @@
+// RxLimit.h
+#ifndef RX_LIMIT_H
+#define RX_LIMIT_H
+
+#include <stdint.h>
+#include "WireFrame.h"
+
+// Per-sender admission control in front of the frame parsers. Each sending
+// MAC gets a token bucket; a frame that finds it empty is dropped before any
+// parsing or flash work. State frames whose sender is itself in an urgent
+// state always pass; relayed urgent records still go through the bucket.
+// A normal board sends about 1.3 frames per second plus short pairing and
+// roster bursts, well inside these limits.
+#define RX_LIMIT_RATE_PER_S 4   // Sustained frames per second per sender
+#define RX_LIMIT_BURST 8        // Bucket depth
+#define RX_LIMIT_SENDERS 16     // Senders tracked; the longest silent one is replaced
+
+// Returns false if the frame from mac should be dropped
+bool rxAdmit(const uint8_t* mac, WireType type, const uint8_t* body, int bodyLen, uint32_t nowMs);
+
+#endif // RX_LIMIT_H
@@ -0,0 +1,254 @@
+#include "SeenMap.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Message.h"
+#include "Metrics.h"
+#include "Utility.h"
+#include <nvs.h>
+
+static_assert(SEEN_BODY_LEN % (MAC_SIZE + 1) == 0, "the body is whole record slots");
+
+static const char* NVS_NAMESPACE = "hiking";
+static const char* NVS_KEY_SEEN_EPISODE = "seenep"; // Last episode we started
+
+struct SeenEntry {
+    bool used;
+    uint8_t origin[MAC_SIZE];
+    uint8_t code;      // The urgent code being confirmed
+    uint8_t episode;   // Origin's counter, bumped each time it turns urgent
+    uint32_t bits;     // Members that have seen it
+    uint32_t changedMs;
+};
+
+static SeenEntry own;                   // Our own urgent episode
+static SeenEntry store[SEEN_STORE_LEN]; // Other origins, oldest overwritten
+static int storeNext = 0;
+static int rotation = 0;
+static uint32_t generation = 0;
+
+// Group members sorted by MAC; the bit order of every bitmap
+static uint8_t members[SEEN_MAX_MEMBERS][MAC_SIZE];
+static int memberCount = 0;
+static uint32_t memberHash = 0;
+static int selfIndex = -1;
+static uint32_t membersPeersGeneration = 0;
+static bool membersBuilt = false;
+static portMUX_TYPE seenMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool macIs(const uint8_t* a, const uint8_t* b) { return memcmp(a, b, MAC_SIZE) == 0; }
+
+static uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void writeLE32(uint8_t* p, uint32_t v) {
+    for (int b = 0; b < 4; ++b) p[b] = (uint8_t)(v >> (8 * b));
+}
+
+static int memberIndex(const uint8_t* mac) {
+    for (int i = 0; i < memberCount; ++i) {
+        if (macIs(members[i], mac)) return i;
+    }
+    return -1;
+}
+
+static uint32_t selfBit() { return selfIndex >= 0 ? 1UL << selfIndex : 0; }
+
+// Receivers only take an episode ahead of the one they hold, so the counter
+// carries on across reboots. Bumped when we turn urgent or change code.
+static uint8_t nextOwnEpisode() {
+    uint32_t episode = 0;
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return (uint8_t)micros();
+    nvs_get_u32(handle, NVS_KEY_SEEN_EPISODE, &episode);
+    episode = (uint8_t)(episode + 1);
+    nvs_set_u32(handle, NVS_KEY_SEEN_EPISODE, episode);
+    if (nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+    nvs_close(handle);
+    return (uint8_t)episode;
+}
+
+static void refreshMembers() {
+    uint32_t peersGen = device.getPeersGeneration();
+    if (membersBuilt && peersGen == membersPeersGeneration) return;
+
+    uint8_t sorted[SEEN_MAX_MEMBERS][MAC_SIZE];
+    int n = 0;
+    memcpy(sorted[n++], device.getMACAddress(), MAC_SIZE);
+    for (const Device::PeerInfo& p : device.getPeerList()) {
+        if (n == SEEN_MAX_MEMBERS) break;
+        if (macIs(p.mac, broadcastAddress) || macIs(p.mac, device.getMACAddress())) continue;
+        memcpy(sorted[n++], p.mac, MAC_SIZE);
+    }
+    // Insertion sort, the list is short
+    for (int i = 1; i < n; ++i) {
+        uint8_t key[MAC_SIZE];
+        memcpy(key, sorted[i], MAC_SIZE);
+        int j = i - 1;
+        for (; j >= 0 && memcmp(sorted[j], key, MAC_SIZE) > 0; --j) memcpy(sorted[j + 1], sorted[j], MAC_SIZE);
+        memcpy(sorted[j + 1], key, MAC_SIZE);
+    }
+    // FNV-1a over the sorted list
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < n; ++i) {
+        for (int b = 0; b < MAC_SIZE; ++b) hash = (hash ^ sorted[i][b]) * 16777619u;
+    }
+
+    portENTER_CRITICAL(&seenMux);
+    bool changed = !membersBuilt || hash != memberHash;
+    memcpy(members, sorted, sizeof(sorted[0]) * n);
+    memberCount = n;
+    memberHash = hash;
+    selfIndex = memberIndex(device.getMACAddress());
+    membersPeersGeneration = peersGen;
+    membersBuilt = true;
+    if (changed) {
+        // Old bitmaps use the old bit order. Ours starts over in the same
+        // episode; copies still out there carry the old hash and are not merged.
+        for (int i = 0; i < SEEN_STORE_LEN; ++i) store[i].used = false;
+        if (own.used) {
+            own.bits = selfBit();
+            own.changedMs = millis();
+        }
+        generation++;
+    }
+    portEXIT_CRITICAL(&seenMux);
+}
+
+void seenOnRecord(const uint8_t* origin, const uint8_t* body) {
+    uint8_t code = body[0];
+    uint8_t episode = body[1];
+    uint32_t hash = readLE32(body + 2);
+    uint32_t bits = readLE32(body + 6);
+    if (!isUrgentCode(code)) return;
+    refreshMembers();
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&seenMux);
+    if (hash != memberHash) {
+        portEXIT_CRITICAL(&seenMux);
+        return;
+    }
+    SeenEntry* e = nullptr;
+    if (macIs(origin, device.getMACAddress())) {
+        // Our own bitmap coming back: only the current episode counts
+        if (own.used && own.code == code && own.episode == episode) e = &own;
+    } else {
+        for (int i = 0; i < SEEN_STORE_LEN && !e; ++i) {
+            if (store[i].used && macIs(store[i].origin, origin)) e = &store[i];
+        }
+        if (!e || (int8_t)(episode - e->episode) > 0) {
+            if (!e) {
+                e = &store[storeNext];
+                storeNext = (storeNext + 1) % SEEN_STORE_LEN;
+            }
+            // A newer episode starts over
+            e->used = true;
+            memcpy(e->origin, origin, MAC_SIZE);
+            e->code = code;
+            e->episode = episode;
+            e->bits = 0;
+        } else if (episode != e->episode) {
+            e = nullptr; // Older than what we hold
+        }
+    }
+    if (e && (e->bits | bits) != e->bits) {
+        e->bits |= bits;
+        e->changedMs = nowMs;
+        generation++;
+    }
+    portEXIT_CRITICAL(&seenMux);
+}
+
+void seenOnState(const uint8_t* origin, uint8_t code) {
+    if (!isUrgentCode(code) || macIs(origin, device.getMACAddress())) return;
+    portENTER_CRITICAL(&seenMux);
+    for (int i = 0; i < SEEN_STORE_LEN; ++i) {
+        SeenEntry& e = store[i];
+        if (!e.used || !macIs(e.origin, origin) || e.code != code) continue;
+        if ((e.bits & selfBit()) == 0) {
+            e.bits |= selfBit();
+            e.changedMs = millis();
+            generation++;
+        }
+        break;
+    }
+    portEXIT_CRITICAL(&seenMux);
+}
+
+static int writeRecord(uint8_t* out, const SeenEntry& e) {
+    memcpy(out, e.origin, MAC_SIZE);
+    out[MAC_SIZE] = SEEN_CODE;
+    uint8_t* body = out + MAC_SIZE + 1;
+    memset(body, 0, SEEN_BODY_LEN);
+    body[0] = e.code;
+    body[1] = e.episode;
+    writeLE32(body + 2, memberHash);
+    writeLE32(body + 6, e.bits);
+    return MAC_SIZE + 1 + SEEN_BODY_LEN;
+}
+
+int seenAppend(uint8_t* out, int room, uint32_t nowMs) {
+    const int recordBytes = MAC_SIZE + 1 + SEEN_BODY_LEN;
+    refreshMembers();
+    uint8_t state = device.getUserState();
+    // Only this function sets own.used and own.code, so they can be read unlocked
+    bool starting = isUrgentCode(state) && (!own.used || own.code != state);
+    uint8_t episode = starting ? nextOwnEpisode() : 0; // Flash work outside the lock
+    int written = 0;
+    portENTER_CRITICAL(&seenMux);
+    if (starting) {
+        // Our bit now means something else
+        own.used = true;
+        memcpy(own.origin, device.getMACAddress(), MAC_SIZE);
+        own.code = state;
+        own.episode = episode;
+        own.bits = selfBit();
+        own.changedMs = nowMs;
+        generation++;
+    } else if (!isUrgentCode(state) && own.used) {
+        own.used = false;
+        generation++;
+    }
+    // Our own bitmap goes first, the others take turns in what room is left
+    if (own.used && room >= recordBytes) written += writeRecord(out, own);
+    int start = rotation;
+    for (int k = 0; k < SEEN_STORE_LEN; ++k) {
+        int i = (start + k) % SEEN_STORE_LEN;
+        SeenEntry& e = store[i];
+        if (!e.used) continue;
+        if (nowMs - e.changedMs >= SEEN_TTL_MS) {
+            e.used = false;
+            continue;
+        }
+        if (written + recordBytes > room) {
+            rotation = i;
+            break;
+        }
+        written += writeRecord(out + written, e);
+        rotation = (i + 1) % SEEN_STORE_LEN;
+    }
+    portEXIT_CRITICAL(&seenMux);
+    return written;
+}
+
+bool seenOwnCount(int& seen, int& members) {
+    portENTER_CRITICAL(&seenMux);
+    bool active = own.used;
+    seen = __builtin_popcount(own.bits & ~selfBit());
+    members = memberCount > 0 ? memberCount - 1 : 0;
+    portEXIT_CRITICAL(&seenMux);
+    return active;
+}
+
+uint32_t seenGeneration() { return generation; }
+
+void seenPrintReport(Print& out) {
+    out.printf("seen members=%d hash=%08lx\n", memberCount, (unsigned long)memberHash);
+    for (int i = -1; i < SEEN_STORE_LEN; ++i) {
+        const SeenEntry& e = i < 0 ? own : store[i];
+        if (!e.used) continue;
+        char mac[MAC_STRING_LEN];
+        out.printf("seen origin=%s code=%s episode=%u bits=%08lx count=%d\n", macToString(e.origin, mac),
+                   MessageMapping(e.code), e.episode, (unsigned long)e.bits, __builtin_popcount(e.bits));
+    }
+}
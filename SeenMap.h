@@ -0,0 +1,40 @@
+// SeenMap.h
+#ifndef SEEN_MAP_H
+#define SEEN_MAP_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Who has seen an urgent state, without one ACK frame per receiver. While a
+// board is urgent it adds a bitmap record for itself to its broadcasts; every
+// board that receives its urgent code, directly or relayed, sets its own bit
+// and rebroadcasts the bitmap, and copies arriving from different paths are
+// ORed together. The origin ends up with the union after a few rounds.
+//
+// Bits index the group members sorted by MAC: ourselves plus our peers. Boards
+// with different member lists would disagree on the bits, so every bitmap
+// carries a 32-bit hash of the list and only bitmaps with our own hash are
+// merged. The episode counter is kept on flash, so after a reboot the origin's
+// next episode is still newer than the one the group holds.
+//
+// A seen record is a normal 7-byte record {origin, SEEN_CODE} followed by two
+// body slots: [urgent code][episode][member hash, 32 bits LE][bitmap, 32 bits LE][4 zero].
+#define SEEN_MAX_MEMBERS 32
+#define SEEN_STORE_LEN 8           // Bitmaps of other origins kept for relaying
+#define SEEN_TTL_MS (10UL * 60UL * 1000UL) // Stop relaying a bitmap unchanged this long
+#define SEEN_BODY_LEN 14
+
+// Merge a received bitmap record
+void seenOnRecord(const uint8_t* origin, const uint8_t* body);
+// We received origin's state (directly or relayed); sets our bit if it is urgent
+void seenOnState(const uint8_t* origin, uint8_t code);
+// Append seen records within room bytes; returns bytes written. Call once per broadcast.
+int seenAppend(uint8_t* out, int room, uint32_t nowMs);
+// Members other than us that have seen our current urgent state, out of how many.
+// False when we are not urgent.
+bool seenOwnCount(int& seen, int& members);
+// Bumped whenever a held bitmap changes
+uint32_t seenGeneration();
+void seenPrintReport(Print& out);
+
+#endif // SEEN_MAP_H
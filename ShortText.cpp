@@ -0,0 +1,288 @@
+#include "ShortText.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Metrics.h"
+#include "Utility.h"
+#include <nvs.h>
+
+// 6-bit alphabet: symbol = index in this string; TEXT_ESCAPE selects a word
+static const char ALPHABET[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,?!-:/'@#+&()*=%\";<>_$";
+static const uint8_t TEXT_ESCAPE = 63;
+
+// Shared dictionary, append only: the index is the wire value (at most 64)
+static const char* const DICTIONARY[] = {
+    "WATER", "CAMP", "TRAIL", "HELP", "LOST", "WAIT", "RIVER", "SUMMIT",
+    "BACK", "NEED", "FOOD", "TENT", "MEET", "NORTH", "SOUTH", "EAST",
+    "WEST", "TURN", "AROUND", "FOUND", "CAR", "PARK", "JUNCTION", "BRIDGE",
+    "LAKE", "PEAK", "RIDGE", "HUT", "SHELTER", "FIRST", "AID", "INJURED",
+    "ANKLE", "KNEE", "SLOW", "GOING", "AHEAD", "BEHIND", "DOWN", "TRAILHEAD",
+    "STOP", "LUNCH", "REST", "HERE", "THERE", "THE", "AND", "ARE",
+    "YOU", "WITH", "LEFT", "RIGHT", "MINUTES", "HOUR", "WEATHER", "STORM",
+    "SNOW", "DARK", "BATTERY", "SIGNAL", "OKAY",
+};
+static const int dictionarySize = sizeof(DICTIONARY) / sizeof(DICTIONARY[0]);
+static_assert(sizeof(DICTIONARY) / sizeof(DICTIONARY[0]) <= 64, "dictionary index is 6 bits");
+static_assert(sizeof(ALPHABET) - 1 <= TEXT_ESCAPE, "alphabet collides with the escape symbol");
+
+static bool isLetter(char c) { return c >= 'A' && c <= 'Z'; }
+
+static uint8_t symbolFor(char c) {
+    if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+    const char* p = strchr(ALPHABET, c);
+    return (p && c) ? (uint8_t)(p - ALPHABET) : (uint8_t)(strchr(ALPHABET, '?') - ALPHABET);
+}
+
+int textEncode(const char* text, uint8_t* symbols, int maxSymbols) {
+    char upper[TEXT_MAX_CHARS + 1];
+    int len = 0;
+    for (; text[len] && len < TEXT_MAX_CHARS; ++len) {
+        char c = text[len];
+        upper[len] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+    }
+    if (text[len]) return -1;
+    upper[len] = '\0';
+
+    int n = 0;
+    for (int i = 0; i < len;) {
+        // A whole dictionary word costs two symbols; only worth it from three letters
+        if (isLetter(upper[i]) && (i == 0 || !isLetter(upper[i - 1]))) {
+            int end = i;
+            while (end < len && isLetter(upper[end])) end++;
+            int wordLen = end - i;
+            int found = -1;
+            for (int w = 0; wordLen >= 3 && w < dictionarySize; ++w) {
+                if ((int)strlen(DICTIONARY[w]) == wordLen && memcmp(DICTIONARY[w], upper + i, wordLen) == 0) {
+                    found = w;
+                    break;
+                }
+            }
+            if (found >= 0) {
+                if (n + 2 > maxSymbols) return -1;
+                symbols[n++] = TEXT_ESCAPE;
+                symbols[n++] = (uint8_t)found;
+                i = end;
+                continue;
+            }
+        }
+        if (n + 1 > maxSymbols) return -1;
+        symbols[n++] = symbolFor(upper[i++]);
+    }
+    return n;
+}
+
+int textDecode(const uint8_t* symbols, int count, char* out, int outMax) {
+    int len = 0;
+    for (int i = 0; i < count; ++i) {
+        const char* piece;
+        char single[2] = {0, 0};
+        if (symbols[i] == TEXT_ESCAPE && i + 1 < count) {
+            uint8_t w = symbols[++i];
+            piece = w < dictionarySize ? DICTIONARY[w] : "?";
+        } else {
+            single[0] = symbols[i] < sizeof(ALPHABET) - 1 ? ALPHABET[symbols[i]] : '?';
+            piece = single;
+        }
+        for (; *piece && len < outMax - 1; ++piece) out[len++] = *piece;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static void packSymbols(const uint8_t* symbols, int count, uint8_t* out) {
+    memset(out, 0, (count * 6 + 7) / 8);
+    for (int i = 0; i < count; ++i) {
+        for (int b = 0; b < 6; ++b) {
+            if (symbols[i] & (0x20 >> b)) {
+                int bit = i * 6 + b;
+                out[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+            }
+        }
+    }
+}
+
+static void unpackSymbols(const uint8_t* packed, int count, uint8_t* symbols) {
+    for (int i = 0; i < count; ++i) {
+        uint8_t s = 0;
+        for (int b = 0; b < 6; ++b) {
+            int bit = i * 6 + b;
+            s = (uint8_t)(s << 1 | ((packed[bit / 8] >> (7 - bit % 8)) & 1));
+        }
+        symbols[i] = s;
+    }
+}
+
+// --- Store ---
+
+struct TextEntry {
+    bool used;
+    uint8_t origin[MAC_SIZE];
+    uint32_t receivedMs;
+    uint8_t body[TEXT_BODY_MAX]; // As on the wire: seq, symbol count, packed symbols
+};
+
+static int bodyLength(const uint8_t* body) { return 2 + (body[1] * 6 + 7) / 8; }
+static int bodySlots(int bodyLen) { return (bodyLen + MAC_SIZE) / (MAC_SIZE + 1); }
+
+// A body with no symbols is a clear: it replaces the text at receivers, is
+// relayed like one, and is never shown
+static bool isCleared(const uint8_t* body) { return body[1] == 0; }
+
+static const char* NVS_NAMESPACE = "hiking";
+static const char* NVS_KEY_TEXT_SEQ = "textseq"; // Last sequence number we sent
+
+static TextEntry own;                  // Our own text, origin is our MAC
+static TextEntry store[TEXT_STORE_LEN]; // Texts from others, oldest overwritten
+static int storeNext = 0;
+static int rotation = 0;               // Next entry to offer, shares the budget fairly
+static uint32_t budgetUs = TEXT_AIRTIME_BURST_US;
+static uint32_t budgetRefillMs = 0;
+static uint32_t generation = 0;
+static portMUX_TYPE textMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Receivers keep a held text unless the new sequence number is ahead of it, so
+// the counter lives on flash: after a reboot it carries on instead of starting
+// over behind what the group still holds. Composing is rare, one commit each.
+static uint8_t nextOwnSeq() {
+    uint32_t seq = 0;
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return (uint8_t)micros();
+    nvs_get_u32(handle, NVS_KEY_TEXT_SEQ, &seq);
+    seq = (uint8_t)(seq + 1);
+    nvs_set_u32(handle, NVS_KEY_TEXT_SEQ, seq);
+    if (nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+    nvs_close(handle);
+    return (uint8_t)seq;
+}
+
+bool shortTextCompose(const char* text) {
+    uint8_t symbols[TEXT_MAX_SYMBOLS];
+    int n = textEncode(text, symbols, TEXT_MAX_SYMBOLS);
+    if (n < 0) return false;
+    portENTER_CRITICAL(&textMux);
+    bool had = own.used;
+    portEXIT_CRITICAL(&textMux);
+    if (n == 0 && !had) return true; // Nothing out there to clear
+    uint8_t seq = nextOwnSeq();
+    portENTER_CRITICAL(&textMux);
+    generation++;
+    own.used = true; // An empty text goes out as a clear until TEXT_TTL_MS
+    memcpy(own.origin, device.getMACAddress(), MAC_SIZE);
+    own.receivedMs = millis();
+    own.body[0] = seq;
+    own.body[1] = (uint8_t)n;
+    packSymbols(symbols, n, own.body + 2);
+    portEXIT_CRITICAL(&textMux);
+    return true;
+}
+
+int shortTextBodySlots(const uint8_t* body, int available) {
+    if (available < 2 || body[1] > TEXT_MAX_SYMBOLS) return 0;
+    int slots = bodySlots(bodyLength(body));
+    return slots * (MAC_SIZE + 1) <= available ? slots : 0;
+}
+
+bool shortTextOnRecord(const uint8_t* origin, const uint8_t* body, int bodyLen) {
+    if (bodyLen < bodyLength(body) || memcmp(origin, device.getMACAddress(), MAC_SIZE) == 0) return false;
+    bool isNew = true;
+    portENTER_CRITICAL(&textMux);
+    TextEntry* slot = nullptr;
+    for (int i = 0; i < TEXT_STORE_LEN; ++i) {
+        if (store[i].used && memcmp(store[i].origin, origin, MAC_SIZE) == 0) {
+            slot = &store[i];
+            break;
+        }
+    }
+    if (slot) {
+        // Sequence numbers wrap; only a newer text replaces the held one
+        isNew = (int8_t)(body[0] - slot->body[0]) > 0;
+    } else {
+        slot = &store[storeNext];
+        storeNext = (storeNext + 1) % TEXT_STORE_LEN;
+    }
+    if (isNew) {
+        slot->used = true;
+        memcpy(slot->origin, origin, MAC_SIZE);
+        slot->receivedMs = millis();
+        memcpy(slot->body, body, bodyLength(body));
+        generation++;
+    }
+    portEXIT_CRITICAL(&textMux);
+    // A clear drops the held text, but there is nothing new to show
+    if (isNew && isCleared(body)) return false;
+    if (isNew) metricInc(METRIC_TEXTS_RECEIVED);
+    return isNew;
+}
+
+static TextEntry* entryAt(int i) { return i == 0 ? &own : &store[i - 1]; }
+
+int shortTextAppend(uint8_t* out, int room, uint32_t nowMs) {
+    const int recordSize = MAC_SIZE + 1;
+    uint32_t elapsed = nowMs - budgetRefillMs;
+    budgetRefillMs = nowMs;
+    budgetUs = min<uint32_t>(TEXT_AIRTIME_BURST_US, budgetUs + min<uint32_t>(elapsed, 10000) * TEXT_AIRTIME_US_PER_S / 1000);
+
+    int written = 0;
+    portENTER_CRITICAL(&textMux);
+    int start = rotation;
+    for (int k = 0; k < TEXT_STORE_LEN + 1; ++k) {
+        int i = (start + k) % (TEXT_STORE_LEN + 1);
+        TextEntry* e = entryAt(i);
+        if (!e->used) continue;
+        if ((i > 0 || isCleared(e->body)) && nowMs - e->receivedMs >= TEXT_TTL_MS) {
+            e->used = false; // Stop relaying stale texts, and our clear once receivers dropped it
+            continue;
+        }
+        int slots = bodySlots(bodyLength(e->body));
+        int bytes = (1 + slots) * recordSize;
+        uint32_t costUs = (uint32_t)bytes * 8; // 1 Mbps
+        if (written + bytes > room || costUs > budgetUs) {
+            rotation = i; // Resume here next frame
+            break;
+        }
+        uint8_t* rec = out + written;
+        memcpy(rec, e->origin, MAC_SIZE);
+        rec[MAC_SIZE] = TEXT_CODE;
+        memset(rec + recordSize, 0, slots * recordSize);
+        memcpy(rec + recordSize, e->body, bodyLength(e->body));
+        written += bytes;
+        budgetUs -= costUs;
+        rotation = (i + 1) % (TEXT_STORE_LEN + 1);
+    }
+    portEXIT_CRITICAL(&textMux);
+    if (written) metricInc(METRIC_TEXTS_SENT);
+    return written;
+}
+
+bool shortTextFrom(const uint8_t* origin, char* out, int outMax) {
+    uint8_t body[TEXT_BODY_MAX];
+    bool found = false;
+    portENTER_CRITICAL(&textMux);
+    for (int i = 0; i < TEXT_STORE_LEN + 1; ++i) {
+        const TextEntry* e = entryAt(i);
+        if (e->used && memcmp(e->origin, origin, MAC_SIZE) == 0) {
+            memcpy(body, e->body, sizeof(body));
+            found = !isCleared(body);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&textMux);
+    if (!found) return false;
+    uint8_t symbols[TEXT_MAX_SYMBOLS];
+    unpackSymbols(body + 2, body[1], symbols);
+    textDecode(symbols, body[1], out, outMax);
+    return true;
+}
+
+uint32_t shortTextGeneration() { return generation; }
+
+void shortTextPrintReport(Print& out) {
+    for (int i = 0; i < TEXT_STORE_LEN + 1; ++i) {
+        const TextEntry* e = entryAt(i);
+        if (!e->used) continue;
+        char mac[MAC_STRING_LEN];
+        char text[TEXT_MAX_CHARS + 1];
+        if (!shortTextFrom(e->origin, text, sizeof(text))) strcpy(text, "(cleared)");
+        out.printf("text from=%s seq=%u age_s=%lu \"%s\"\n", macToString(e->origin, mac), e->body[0],
+                   (unsigned long)((millis() - e->receivedMs) / 1000), text);
+    }
+}
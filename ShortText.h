@@ -0,0 +1,45 @@
+// ShortText.h
+#ifndef SHORT_TEXT_H
+#define SHORT_TEXT_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Short free text ("WATER AT CAMP 2") carried in the state frame after the
+// status records. A text record is a normal 7-byte record {origin, TEXT_CODE}
+// followed by its body in whole 7-byte slots:
+//   [seq][symbol count][symbols packed 6 bits each, MSB first]
+// A symbol count of 0 is a clear: it replaces the origin's text everywhere.
+// The sequence number survives reboots, so a newer text always wins.
+// Symbols are a 6-bit alphabet, plus an escape that selects a word from a
+// shared dictionary. Texts only use frame space the status records left over
+// and are limited by their own airtime budget, so they never displace codes.
+#define TEXT_MAX_SYMBOLS 24
+#define TEXT_MAX_CHARS 48      // Decoded length bound, dictionary words included
+#define TEXT_BODY_MAX (2 + (TEXT_MAX_SYMBOLS * 6 + 7) / 8)
+#define TEXT_STORE_LEN 8       // Texts from others kept for display and relay
+#define TEXT_TTL_MS (30UL * 60UL * 1000UL)
+#define TEXT_AIRTIME_US_PER_S 400 // Budget refill: airtime per second of text records
+#define TEXT_AIRTIME_BURST_US 1000
+
+// Encode into 6-bit symbols; returns the symbol count or -1 if it does not fit
+int textEncode(const char* text, uint8_t* symbols, int maxSymbols);
+// Decode symbols into out (NUL terminated); returns the length
+int textDecode(const uint8_t* symbols, int count, char* out, int outMax);
+
+// Set our own text; an empty string clears it, and the clear is sent so
+// receivers drop what they hold. Returns false if too long.
+bool shortTextCompose(const char* text);
+// Slots (7 bytes each) taken by the body starting at body, 0 if malformed
+int shortTextBodySlots(const uint8_t* body, int available);
+// Store a received text or clear; returns true if it is a new text to show
+bool shortTextOnRecord(const uint8_t* origin, const uint8_t* body, int bodyLen);
+// Append text records within room bytes and the airtime budget; returns bytes written
+int shortTextAppend(uint8_t* out, int room, uint32_t nowMs);
+// Latest text from origin, decoded; false if none is held
+bool shortTextFrom(const uint8_t* origin, char* out, int outMax);
+// Bumped whenever a stored text changes, for redraw checks
+uint32_t shortTextGeneration();
+void shortTextPrintReport(Print& out);
+
+#endif // SHORT_TEXT_H
@@ -0,0 +1,77 @@
+#include "Trace.h"
+#include "Metrics.h"
+#include "Power.h"
+
+static TraceRecord ring[TRACE_RING_LEN];
+static uint16_t ringHead = 0; // Next record to write
+static uint16_t ringCount = 0;
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+static bool streaming = false;
+
+static void push(const TraceRecord& rec) {
+    portENTER_CRITICAL(&traceMux);
+    ring[ringHead] = rec;
+    ringHead = (ringHead + 1) % TRACE_RING_LEN;
+    if (ringCount < TRACE_RING_LEN) {
+        ringCount++;
+    } else {
+        metricInc(METRIC_TRACE_DROPS); // Overwrote the oldest undrained record
+    }
+    portEXIT_CRITICAL(&traceMux);
+}
+
+void traceU32(uint8_t level, TraceEvent event, uint32_t a, uint32_t b) {
+    TraceRecord rec;
+    rec.timeUs = micros();
+    rec.event = event;
+    rec.level = level;
+    rec.reserved = 0;
+    memcpy(rec.args, &a, 4);
+    memcpy(rec.args + 4, &b, 4);
+    push(rec);
+}
+
+void traceRecord(uint8_t level, TraceEvent event, const uint8_t* mac, uint8_t code, uint8_t index) {
+    TraceRecord rec;
+    rec.timeUs = micros();
+    rec.event = event;
+    rec.level = level;
+    rec.reserved = 0;
+    memcpy(rec.args, mac, 6);
+    rec.args[6] = code;
+    rec.args[7] = index;
+    push(rec);
+}
+
+void traceSetStreaming(bool on) {
+    streaming = on;
+}
+
+void traceDrain() {
+    if (!streaming) return;
+    for (int n = 0; n < TRACE_DRAIN_BATCH; ++n) {
+        // Never block the loop on a full UART buffer
+        if (Serial.availableForWrite() < (int)TRACE_FRAME_SIZE) return;
+        TraceRecord rec;
+        portENTER_CRITICAL(&traceMux);
+        bool have = ringCount > 0;
+        if (have) {
+            rec = ring[(ringHead + TRACE_RING_LEN - ringCount) % TRACE_RING_LEN];
+            ringCount--;
+        }
+        portEXIT_CRITICAL(&traceMux);
+        if (!have) return;
+
+        uint8_t frame[TRACE_FRAME_SIZE];
+        frame[0] = TRACE_SYNC0;
+        frame[1] = TRACE_SYNC1;
+        memcpy(frame + 2, &rec, sizeof(rec));
+        frame[TRACE_FRAME_SIZE - 1] = traceChecksum(frame + 2, sizeof(rec));
+        Serial.write(frame, sizeof(frame));
+    }
+}
+
+uint32_t traceMsUntilDrain() {
+    if (!streaming || ringCount == 0) return POWER_NO_DEADLINE;
+    return TRACE_DRAIN_RETRY_MS;
+}
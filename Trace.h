@@ -0,0 +1,51 @@
+// Trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "TraceFormat.h"
+
+// Events above this level compile to nothing
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+#define TRACE_RING_LEN 128     // Records kept in RAM until drained
+#define TRACE_DRAIN_BATCH 8    // Records written per idle pass
+#define TRACE_DRAIN_RETRY_MS 10 // Revisit a backlog after the UART has drained a bit
+
+// Record into the ring; cheap and safe from the radio callbacks
+void traceU32(uint8_t level, TraceEvent event, uint32_t a, uint32_t b);
+void traceRecord(uint8_t level, TraceEvent event, const uint8_t* mac, uint8_t code, uint8_t index);
+// Write pending records to Serial without blocking; call from idle time
+void traceDrain();
+// Milliseconds until the next drain pass is useful, POWER_NO_DEADLINE if idle
+uint32_t traceMsUntilDrain();
+// Streaming is off by default so the serial monitor stays readable
+void traceSetStreaming(bool on);
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(event, a, b) traceU32(TRACE_LEVEL_ERROR, event, a, b)
+#else
+#define TRACE_ERROR(event, a, b) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_WARN
+#define TRACE_WARN(event, a, b) traceU32(TRACE_LEVEL_WARN, event, a, b)
+#else
+#define TRACE_WARN(event, a, b) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(event, a, b) traceU32(TRACE_LEVEL_INFO, event, a, b)
+#else
+#define TRACE_INFO(event, a, b) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(event, a, b) traceU32(TRACE_LEVEL_DEBUG, event, a, b)
+#define TRACE_DEBUG_RECORD(event, mac, code, index) traceRecord(TRACE_LEVEL_DEBUG, event, mac, code, index)
+#else
+#define TRACE_DEBUG(event, a, b) do {} while (0)
+#define TRACE_DEBUG_RECORD(event, mac, code, index) do {} while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,59 @@
+// TraceFormat.h
+// Binary trace record layout and event catalog, shared by the firmware
+// (Trace.h) and the host decoder (tools/trace_decode.cpp).
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_WARN 2
+#define TRACE_LEVEL_INFO 3
+#define TRACE_LEVEL_DEBUG 4
+
+// How the 8 argument bytes of a record are interpreted
+enum TraceArgs : uint8_t {
+    TRACE_ARGS_U32,     // a, b: two little-endian uint32
+    TRACE_ARGS_RECORD   // sender MAC (6 bytes), code, index
+};
+
+// X(id, name, args, text) - append only, the id is the wire value
+#define TRACE_EVENT_LIST(X) \
+    X(TRACE_BOOT,             "boot",             TRACE_ARGS_U32,    "boot") \
+    X(TRACE_TX_FRAME,         "tx_frame",         TRACE_ARGS_U32,    "broadcast records=%u bytes=%u") \
+    X(TRACE_TX_RECORD,        "tx_record",        TRACE_ARGS_RECORD, "broadcast record") \
+    X(TRACE_RX_FRAME,         "rx_frame",         TRACE_ARGS_U32,    "received records=%u bytes=%u") \
+    X(TRACE_RX_RECORD,        "rx_record",        TRACE_ARGS_RECORD, "parsed record") \
+    X(TRACE_RX_REJECT,        "rx_reject",        TRACE_ARGS_U32,    "rejected frame bytes=%u reason=%u") \
+    X(TRACE_SEND_FAIL,        "send_fail",        TRACE_ARGS_U32,    "send status fail") \
+    X(TRACE_DRIVER_ERROR,     "driver_error",     TRACE_ARGS_U32,    "esp_now_send error=%u len=%u") \
+    X(TRACE_RADIO_ERROR,      "radio_error",      TRACE_ARGS_U32,    "radio switch error=%u on=%u") \
+    X(TRACE_NVS_COMMIT,       "nvs_commit",       TRACE_ARGS_U32,    "nvs commit inbox=%u peers=%u") \
+    X(TRACE_URGENT_UNTRACKED, "urgent_untracked", TRACE_ARGS_U32,    "urgent delivery skips peers=%u max=%u")
+
+#define TRACE_EVENT_ENUM(id, name, args, text) id,
+enum TraceEvent : uint16_t { TRACE_EVENT_LIST(TRACE_EVENT_ENUM) TRACE_EVENT_COUNT };
+#undef TRACE_EVENT_ENUM
+
+struct __attribute__((packed)) TraceRecord {
+    uint32_t timeUs;   // micros(), wraps every ~71 minutes
+    uint16_t event;    // TraceEvent
+    uint8_t level;
+    uint8_t reserved;
+    uint8_t args[8];
+};
+
+// On the wire each record is framed as SYNC0 SYNC1 <16 record bytes> <checksum>,
+// so it can be picked out of a serial capture that also holds text output
+#define TRACE_SYNC0 0xA5
+#define TRACE_SYNC1 0x5A
+#define TRACE_FRAME_SIZE (2 + sizeof(TraceRecord) + 1)
+
+inline uint8_t traceChecksum(const uint8_t* data, unsigned len) {
+    uint8_t sum = 0;
+    for (unsigned i = 0; i < len; ++i) sum = (uint8_t)((sum << 1 | sum >> 7) ^ data[i]);
+    return sum;
+}
+
+#endif // TRACE_FORMAT_H
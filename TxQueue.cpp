@@ -0,0 +1,171 @@
+#include "TxQueue.h"
+#include "Communication.h"
+#include "Power.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Capture.h"
+
+struct TxFrame {
+    uint8_t dest[MAC_SIZE];
+    uint16_t len;
+    TxPriority prio;
+    TxCoalesceKey key;
+    uint32_t seq; // FIFO order within a priority
+    uint8_t data[TX_FRAME_MAX];
+};
+
+// Queue slots, touched only by the loop task
+static TxFrame frames[TX_QUEUE_LEN];
+static bool used[TX_QUEUE_LEN] = {false};
+static int depth = 0;
+static uint32_t nextSeq = 0;
+
+// Credits and in-flight send times, shared with the send callback.
+// ESP-NOW completes sends in order, so the oldest in-flight time matches.
+static portMUX_TYPE txMux = portMUX_INITIALIZER_UNLOCKED;
+static int credits = TX_CREDITS;
+static uint32_t inflightUs[TX_CREDITS];
+static uint8_t inflightHead = 0;
+static uint8_t inflightCount = 0;
+
+bool txEnqueue(const uint8_t* dest, const uint8_t* data, uint16_t len, TxPriority prio, TxCoalesceKey key) {
+    if (len > TX_FRAME_MAX) return false;
+    int slot = -1;
+    if (key != TX_KEY_NONE) {
+        for (int i = 0; i < TX_QUEUE_LEN; ++i) {
+            if (used[i] && frames[i].key == key && memcmp(frames[i].dest, dest, MAC_SIZE) == 0) {
+                slot = i;
+                metricInc(METRIC_TX_COALESCED);
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        for (int i = 0; i < TX_QUEUE_LEN; ++i) {
+            if (!used[i]) {
+                slot = i;
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        // Full: evict the oldest frame of the lowest priority below ours
+        for (int i = 0; i < TX_QUEUE_LEN; ++i) {
+            if (frames[i].prio >= prio) continue;
+            if (slot < 0 || frames[i].prio < frames[slot].prio ||
+                (frames[i].prio == frames[slot].prio && frames[i].seq < frames[slot].seq)) {
+                slot = i;
+            }
+        }
+        metricInc(METRIC_TX_DROPPED);
+        if (slot < 0) return false; // Nothing less important to make room
+        used[slot] = false;
+        depth--;
+    }
+    TxFrame& f = frames[slot];
+    if (!used[slot]) {
+        used[slot] = true;
+        depth++;
+        f.seq = nextSeq++;
+    }
+    memcpy(f.dest, dest, MAC_SIZE);
+    memcpy(f.data, data, len);
+    f.len = len;
+    f.prio = prio;
+    f.key = key;
+    metricInc(METRIC_TX_ENQUEUED);
+    metricSet(METRIC_TX_DEPTH, depth);
+    metricMax(METRIC_TX_DEPTH_MAX, depth);
+    return true;
+}
+
+static int nextFrame() {
+    int best = -1;
+    for (int i = 0; i < TX_QUEUE_LEN; ++i) {
+        if (!used[i]) continue;
+        if (best < 0 || frames[i].prio > frames[best].prio ||
+            (frames[i].prio == frames[best].prio && frames[i].seq < frames[best].seq)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void reclaimStaleCredits() {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&txMux);
+    while (inflightCount > 0 && now - inflightUs[inflightHead] > TX_CREDIT_TIMEOUT_MS * 1000) {
+        inflightHead = (inflightHead + 1) % TX_CREDITS;
+        inflightCount--;
+        credits++;
+        metricInc(METRIC_TX_CREDIT_TIMEOUTS);
+    }
+    portEXIT_CRITICAL(&txMux);
+}
+
+void txPump() {
+    reclaimStaleCredits();
+    while (depth > 0) {
+        portENTER_CRITICAL(&txMux);
+        bool haveCredit = credits > 0;
+        if (haveCredit) {
+            credits--;
+            inflightUs[(inflightHead + inflightCount) % TX_CREDITS] = micros();
+            inflightCount++;
+        }
+        portEXIT_CRITICAL(&txMux);
+        if (!haveCredit) return;
+
+        int i = nextFrame();
+        TxFrame& f = frames[i];
+        esp_err_t result = esp_now_send(f.dest, f.data, f.len);
+        if (result != ESP_OK) {
+            // Keep the frame (e.g. ESP_ERR_ESPNOW_NO_MEM) and give the credit back
+            portENTER_CRITICAL(&txMux);
+            inflightCount--;
+            credits++;
+            portEXIT_CRITICAL(&txMux);
+            metricInc(METRIC_TX_DRIVER_ERRORS);
+            TRACE_WARN(TRACE_DRIVER_ERROR, (uint32_t)result, f.len);
+            return;
+        }
+        powerNoteTx(f.len);
+        captureFrame(CAPTURE_TX, f.dest, 0, f.data, f.len);
+        used[i] = false;
+        depth--;
+        metricSet(METRIC_TX_DEPTH, depth);
+        metricInc(METRIC_FRAMES_SENT);
+    }
+}
+
+void txOnSendComplete() {
+    uint32_t now = micros();
+    bool matched = false;
+    uint32_t latency = 0;
+    portENTER_CRITICAL(&txMux);
+    if (inflightCount > 0) {
+        latency = now - inflightUs[inflightHead];
+        inflightHead = (inflightHead + 1) % TX_CREDITS;
+        inflightCount--;
+        credits++;
+        matched = true;
+    }
+    portEXIT_CRITICAL(&txMux);
+    if (matched) histogramRecord(HIST_TX_LATENCY_US, latency);
+}
+
+uint32_t txMsUntilNext() {
+    if (depth == 0) return 0xFFFFFFFFUL;
+    // Woken by the send callback; the deadline only covers a lost completion
+    uint32_t now = micros();
+    uint32_t wait = 0;
+    portENTER_CRITICAL(&txMux);
+    if (credits == 0 && inflightCount > 0) {
+        uint32_t heldUs = now - inflightUs[inflightHead];
+        uint32_t timeoutUs = TX_CREDIT_TIMEOUT_MS * 1000;
+        // reclaimStaleCredits wants strictly more than the timeout
+        if (heldUs <= timeoutUs) wait = (timeoutUs - heldUs) / 1000 + 1;
+    }
+    portEXIT_CRITICAL(&txMux);
+    return wait;
+}
@@ -0,0 +1,39 @@
+// TxQueue.h
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <esp_now.h>
+
+#define TX_QUEUE_LEN 8
+#define TX_FRAME_MAX 250          // ESP_NOW_MAX_DATA_LEN
+#define TX_CREDITS 2              // Frames handed to the driver ahead of their completion
+#define TX_CREDIT_TIMEOUT_MS 200  // Reclaim a credit whose completion never arrived
+
+enum TxPriority : uint8_t {
+    TX_PRIO_LOW,    // Droppable background traffic
+    TX_PRIO_NORMAL, // Periodic state broadcast
+    TX_PRIO_URGENT  // Urgent unicasts
+};
+
+// Frames with the same non-zero key and destination replace each other while queued
+enum TxCoalesceKey : uint8_t {
+    TX_KEY_NONE,
+    TX_KEY_STATE,  // Self state + carry list broadcast; only the newest matters
+    TX_KEY_PAIRING, // Pairing request; a retry replaces one still queued
+    TX_KEY_ROSTER   // Roster summary
+};
+
+// Queue a frame; returns false if it was dropped under backpressure
+bool txEnqueue(const uint8_t* dest, const uint8_t* data, uint16_t len,
+               TxPriority prio, TxCoalesceKey key = TX_KEY_NONE);
+// Hand queued frames to the driver while send credits remain; call from the loop
+void txPump();
+// Feed every send-complete callback; releases one credit
+void txOnSendComplete();
+// 0 when a frame can go now; otherwise until the oldest credit times out.
+// In-flight sends are stamped with micros(), so this reads the clock itself.
+uint32_t txMsUntilNext();
+
+#endif // TX_QUEUE_H
@@ -0,0 +1,213 @@
+#include "UrgentDelivery.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Utility.h"
+#include "TxQueue.h"
+#include "WireFrame.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+struct PeerDelivery {
+    uint8_t mac[MAC_SIZE];
+    bool delivered;
+    bool inFlight;
+    bool registered; // Holds an ESP-NOW peer table entry
+    uint8_t attempts;
+    uint32_t nextTryMs;
+    uint32_t sentMs;
+};
+
+static PeerDelivery peers[URGENT_MAX_PEERS];
+static int peerCount = 0;
+static int untrackedCount = 0;
+static int registeredCount = 0;
+static uint8_t episodeCode = 0;  // Urgent code being delivered, 0 when idle
+static uint32_t syncedPeersGeneration = 0;
+static volatile uint32_t generation = 0;
+static portMUX_TYPE deliveryMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Loop only. Returns false while the ESP-NOW peer table has no free entry.
+static esp_err_t registerPeer(PeerDelivery& p) {
+    if (p.registered) return ESP_OK;
+    if (registeredCount >= URGENT_ESPNOW_SLOTS) return ESP_ERR_ESPNOW_FULL;
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, p.mac, MAC_SIZE);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    peerInfo.ifidx = WIFI_IF_STA;
+    esp_err_t result = esp_now_is_peer_exist(p.mac) ? ESP_OK : esp_now_add_peer(&peerInfo);
+    if (result == ESP_OK) {
+        p.registered = true;
+        registeredCount++;
+    }
+    return result;
+}
+
+// Loop only
+static void unregisterPeer(PeerDelivery& p) {
+    if (!p.registered) return;
+    esp_now_del_peer(p.mac);
+    p.registered = false;
+    registeredCount--;
+}
+
+// Start a fresh episode, or keep results for peers that are still paired.
+// Peers that were dropped give their ESP-NOW entry back.
+static void syncPeers(bool newEpisode) {
+    PeerDelivery old[URGENT_MAX_PEERS];
+    portENTER_CRITICAL(&deliveryMux);
+    int oldCount = peerCount;
+    memcpy(old, peers, sizeof(PeerDelivery) * oldCount);
+    portEXIT_CRITICAL(&deliveryMux);
+
+    const auto& list = device.getPeerList();
+    // Index 0 is the broadcast entry
+    int listed = list.size() > 0 ? (int)list.size() - 1 : 0;
+    PeerDelivery next[URGENT_MAX_PEERS];
+    int nextCount = 0;
+    for (int i = 1; i <= listed && nextCount < URGENT_MAX_PEERS; ++i) {
+        PeerDelivery& p = next[nextCount++];
+        memset(&p, 0, sizeof(p));
+        memcpy(p.mac, list[i].mac, MAC_SIZE);
+        for (int j = 0; j < oldCount; ++j) {
+            if (memcmp(old[j].mac, p.mac, MAC_SIZE) != 0) continue;
+            if (newEpisode) p.registered = old[j].registered;
+            else p = old[j];
+            old[j].registered = false; // Carried over, not dropped
+            break;
+        }
+    }
+    for (int j = 0; j < oldCount; ++j) unregisterPeer(old[j]);
+    if (listed > nextCount) TRACE_WARN(TRACE_URGENT_UNTRACKED, (uint32_t)(listed - nextCount), URGENT_MAX_PEERS);
+
+    portENTER_CRITICAL(&deliveryMux);
+    memcpy(peers, next, sizeof(PeerDelivery) * nextCount);
+    peerCount = nextCount;
+    untrackedCount = listed - nextCount;
+    generation++;
+    portEXIT_CRITICAL(&deliveryMux);
+    syncedPeersGeneration = device.getPeersGeneration();
+}
+
+void urgentDeliveryTick(uint32_t nowMs) {
+    uint8_t state = device.getUserState();
+    uint8_t code = isUrgentCode(state) ? state : (uint8_t)CODE_NEUTRAL;
+    if (code != episodeCode) {
+        episodeCode = code;
+        syncPeers(true);
+    } else if (device.getPeersGeneration() != syncedPeersGeneration) {
+        syncPeers(false);
+    }
+    if (!episodeCode) {
+        // Nothing to unicast: free the ESP-NOW table
+        for (int i = 0; i < peerCount && registeredCount > 0; ++i) unregisterPeer(peers[i]);
+        return;
+    }
+
+    // A state frame holding only our own record
+    uint8_t frame[WIRE_HEADER_LEN + MAC_SIZE + 1];
+    memcpy(frame + WIRE_HEADER_LEN, device.getMACAddress(), MAC_SIZE);
+    frame[WIRE_HEADER_LEN + MAC_SIZE] = episodeCode;
+    wireSeal(frame, WIRE_STATE, MAC_SIZE + 1);
+
+    for (int i = 0; i < peerCount; ++i) {
+        PeerDelivery& p = peers[i];
+        // A frame dropped by the TX queue never completes; count it as a failure
+        if (p.inFlight && nowMs - p.sentMs > URGENT_INFLIGHT_TIMEOUT_MS) {
+            urgentDeliveryOnSendResult(p.mac, ESP_NOW_SEND_FAIL);
+        }
+        if (p.delivered) {
+            unregisterPeer(p);
+            continue;
+        }
+        if (p.inFlight || (int32_t)(nowMs - p.nextTryMs) < 0) continue;
+        esp_err_t added = registerPeer(p);
+        if (added == ESP_ERR_ESPNOW_FULL) continue; // Waits for an acknowledged peer's entry
+        if (added != ESP_OK) {
+            // Counts as a failed attempt so it backs off and shows in the report
+            metricInc(METRIC_SEND_FAILURES);
+            p.inFlight = true;
+            urgentDeliveryOnSendResult(p.mac, ESP_NOW_SEND_FAIL);
+            continue;
+        }
+        p.inFlight = true;
+        p.sentMs = nowMs;
+        if (!txEnqueue(p.mac, frame, sizeof(frame), TX_PRIO_URGENT)) {
+            // Queue full of urgent frames: try again on the next tick
+            p.inFlight = false;
+            p.nextTryMs = nowMs + URGENT_RETRY_BASE_MS;
+        }
+    }
+}
+
+void urgentDeliveryOnSendResult(const uint8_t* mac, esp_now_send_status_t status) {
+    portENTER_CRITICAL(&deliveryMux);
+    for (int i = 0; i < peerCount; ++i) {
+        PeerDelivery& p = peers[i];
+        if (!p.inFlight || memcmp(p.mac, mac, MAC_SIZE) != 0) continue;
+        p.inFlight = false;
+        if (status == ESP_NOW_SEND_SUCCESS) {
+            p.delivered = true;
+        } else {
+            // Exponential backoff between unacknowledged attempts
+            uint32_t backoff = URGENT_RETRY_BASE_MS << (p.attempts < 6 ? p.attempts : 6);
+            if (backoff > URGENT_RETRY_MAX_MS) backoff = URGENT_RETRY_MAX_MS;
+            if (p.attempts < 255) p.attempts++;
+            p.nextTryMs = millis() + backoff;
+        }
+        generation++;
+        break;
+    }
+    portEXIT_CRITICAL(&deliveryMux);
+}
+
+uint32_t urgentDeliveryMsUntilNext(uint32_t nowMs) {
+    uint32_t wait = 0xFFFFFFFFUL;
+    if (!episodeCode) return wait;
+    for (int i = 0; i < peerCount; ++i) {
+        const PeerDelivery& p = peers[i];
+        if (p.delivered) continue;
+        if (p.inFlight) {
+            int32_t timeout = (int32_t)(p.sentMs + URGENT_INFLIGHT_TIMEOUT_MS - nowMs);
+            uint32_t ms = timeout > 0 ? (uint32_t)timeout : 0;
+            if (ms < wait) wait = ms;
+            continue;
+        }
+        int32_t left = (int32_t)(p.nextTryMs - nowMs);
+        uint32_t ms = left > 0 ? (uint32_t)left : 0;
+        if (ms < wait) wait = ms;
+    }
+    return wait;
+}
+
+int urgentDeliveredCount() {
+    int n = 0;
+    for (int i = 0; i < peerCount; ++i) {
+        if (peers[i].delivered) n++;
+    }
+    return n;
+}
+
+int urgentPeerCount() {
+    return peerCount;
+}
+
+int urgentUntrackedCount() {
+    return untrackedCount;
+}
+
+uint32_t urgentDeliveryGeneration() {
+    return generation;
+}
+
+void urgentDeliveryPrintReport(Print& out) {
+    out.printf("delivery code=%u peers=%d delivered=%d untracked=%d espnow_entries=%d\n", episodeCode, peerCount,
+               urgentDeliveredCount(), untrackedCount, registeredCount);
+    for (int i = 0; i < peerCount; ++i) {
+        const PeerDelivery& p = peers[i];
+        char macStr[MAC_STRING_LEN];
+        out.printf("delivery_peer mac=%s delivered=%d attempts=%u waiting_for_entry=%d\n", macToString(p.mac, macStr),
+                   p.delivered ? 1 : 0, p.attempts, !p.delivered && !p.registered && episodeCode ? 1 : 0);
+    }
+}
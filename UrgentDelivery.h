@@ -0,0 +1,32 @@
+// UrgentDelivery.h
+#ifndef URGENT_DELIVERY_H
+#define URGENT_DELIVERY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <esp_now.h>
+
+// While our own state is urgent (SOS, INJURED) it is also unicast to every
+// peer, using ESP-NOW's link-layer ACK to learn who actually received it.
+#define URGENT_RETRY_BASE_MS 200   // First retry delay, doubled per failure
+#define URGENT_RETRY_MAX_MS 10000
+#define URGENT_INFLIGHT_TIMEOUT_MS 1000 // No completion by then counts as a failed attempt
+#define URGENT_MAX_PEERS 32        // Peers tracked per episode, a full roster or seen-by group
+#define URGENT_ESPNOW_SLOTS 19     // ESP-NOW peer table minus the broadcast entry; acknowledged
+                                   // peers give their entry back so the rest get a turn
+
+// Sends due unicasts; call from the loop
+void urgentDeliveryTick(uint32_t nowMs);
+// Feed every send-complete callback
+void urgentDeliveryOnSendResult(const uint8_t* mac, esp_now_send_status_t status);
+uint32_t urgentDeliveryMsUntilNext(uint32_t nowMs);
+// Peers that have acknowledged the current urgent state, out of how many
+int urgentDeliveredCount();
+int urgentPeerCount();
+// Peers beyond URGENT_MAX_PEERS that this episode cannot reach
+int urgentUntrackedCount();
+// Bumped whenever a delivery result changes
+uint32_t urgentDeliveryGeneration();
+void urgentDeliveryPrintReport(Print& out);
+
+#endif // URGENT_DELIVERY_H
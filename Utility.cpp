@@ -1,37 +1,28 @@
 #include <Arduino.h>
 #include "Utility.h"
-#include <cstdio>
-#include <cstring>
 
-// Utility: Convert MAC address array to string
-std::string macToString(const uint8_t* mac, size_t size) {
-    char macStr[18];
-    if (size == 6 && mac) {
-        snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        return std::string(macStr);
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// Utility: Format a MAC address without going through snprintf or the heap
+char* macToString(const uint8_t* mac, char* out) {
+    char* p = out;
+    for (int i = 0; i < MAC_SIZE; ++i) {
+        if (i > 0) *p++ = ':';
+        *p++ = HEX_DIGITS[mac[i] >> 4];
+        *p++ = HEX_DIGITS[mac[i] & 0x0F];
     }
-    return std::string();
+    *p = '\0';
+    return out;
 }
 
-// Utility: Copy MAC address from std::vector<uint8_t> to uint8_t array
-// void copyMacToArray(const std::vector<uint8_t>& src, uint8_t dest[6]) {
-//     for (int i = 0; i < 6; ++i) {
-//         dest[i] = (i < src.size()) ? src[i] : 0;
-//     }
-// }
-
-// Convert std::vector<uint8_t> MAC to Arduino String
-// String macToString_Arduino(const std::vector<uint8_t>& mac) {
-//     return String(macToString(mac.data(), mac.size()).c_str());
-// }
-
-// Overload for uint8_t* and size
-String macToString_Arduino(const uint8_t* mac, size_t size) {
-    return String(macToString(mac, size).c_str());
+// Overload for std::array<uint8_t, 6>
+char* macToString(const std::array<uint8_t, MAC_SIZE>& mac, char* out) {
+    return macToString(mac.data(), out);
 }
 
-// Overload for std::array<uint8_t, 6>
-String macToString_Arduino(const std::array<uint8_t, 6>& mac) {
-    return String(macToString(mac.data(), mac.size()).c_str());
-}
\ No newline at end of file
+char* macToInitials(const uint8_t* mac, char* out) {
+    out[0] = HEX_DIGITS[mac[MAC_SIZE - 1] >> 4];
+    out[1] = HEX_DIGITS[mac[MAC_SIZE - 1] & 0x0F];
+    out[2] = '\0';
+    return out;
+}
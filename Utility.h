@@ -1,12 +1,13 @@
+#pragma once
 #include <Arduino.h>
-#include <string>
-#include <vector>
 #include "Communication.h"
 
-// Utility: Convert MAC address array to string
-std::string macToString(const uint8_t* mac, size_t size);
+#define MAC_STRING_LEN 18 // "XX:XX:XX:XX:XX:XX" plus terminator
+#define INITIALS_LEN 3    // Two characters plus terminator
 
+// Utility: Format a MAC address into out (MAC_STRING_LEN bytes), returns out
+char* macToString(const uint8_t* mac, char* out);
+char* macToString(const std::array<uint8_t, MAC_SIZE>& mac, char* out);
 
-// Convert std::vector<uint8_t> MAC to Arduino String
-String macToString_Arduino(const uint8_t* mac, size_t size);
-String macToString_Arduino(const std::array<uint8_t, MAC_SIZE>& mac);
\ No newline at end of file
+// Fallback initials for a MAC without a name: its last byte in hex, returns out
+char* macToInitials(const uint8_t* mac, char* out);
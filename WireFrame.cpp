@@ -0,0 +1,91 @@
+#include "WireFrame.h"
+#include <stddef.h>
+#include <string.h>
+#include <esp_rom_crc.h>
+#include <nvs.h>
+#include "Metrics.h"
+#include "Trace.h"
+
+static const char* NVS_NAMESPACE = "hiking";
+static const char* NVS_KEY_GROUP = "group";
+// Written from the loop, read by the receive callback; one aligned halfword
+static volatile uint16_t groupId = wireGroupId(WIRE_GROUP_NAME);
+static const int CRC_COVERED = offsetof(WireHeader, crc);
+// Trace reject reasons, after ParseMessages' 1-3
+static const uint32_t REJECT_REASON_VERSION = 10;
+static const uint32_t REJECT_REASON_CRC = 11;
+
+static uint32_t frameCrc(const uint8_t* frame, const uint8_t* body, int bodyLen) {
+    uint32_t crc = esp_rom_crc32_le(0, frame, CRC_COVERED);
+    return esp_rom_crc32_le(crc, body, bodyLen);
+}
+
+void wireSetup() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    uint32_t stored;
+    if (nvs_get_u32(handle, NVS_KEY_GROUP, &stored) == ESP_OK) groupId = (uint16_t)stored;
+    nvs_close(handle);
+}
+
+bool wireSetGroup(const char* name) {
+    if (strlen(name) > WIRE_GROUP_NAME_MAX) return false;
+    uint16_t id = wireGroupId(*name ? name : WIRE_GROUP_NAME);
+    groupId = id;
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return true;
+    if (*name) nvs_set_u32(handle, NVS_KEY_GROUP, id);
+    else nvs_erase_key(handle, NVS_KEY_GROUP);
+    if (nvs_commit(handle) == ESP_OK) metricInc(METRIC_NVS_COMMITS);
+    nvs_close(handle);
+    return true;
+}
+
+uint16_t wireGroup() { return groupId; }
+
+int wireSeal(uint8_t* frame, WireType type, int bodyLen) {
+    WireHeader h;
+    h.magic[0] = WIRE_MAGIC0;
+    h.magic[1] = WIRE_MAGIC1;
+    h.version = WIRE_VERSION;
+    h.type = type;
+    h.group = groupId;
+    memcpy(frame, &h, CRC_COVERED);
+    h.crc = frameCrc(frame, frame + WIRE_HEADER_LEN, bodyLen);
+    memcpy(frame + CRC_COVERED, &h.crc, sizeof(h.crc));
+    return WIRE_HEADER_LEN + bodyLen;
+}
+
+WireType wireOpen(const uint8_t* frame, int len, const uint8_t** body, int* bodyLen) {
+    if (len < WIRE_HEADER_LEN) {
+        metricInc(METRIC_REJECT_SHORT);
+        return WIRE_INVALID;
+    }
+    if (frame[0] != WIRE_MAGIC0 || frame[1] != WIRE_MAGIC1) {
+        metricInc(METRIC_REJECT_MAGIC);
+        return WIRE_INVALID;
+    }
+    WireHeader h;
+    memcpy(&h, frame, sizeof(h));
+    if (h.version != WIRE_VERSION) {
+        metricInc(METRIC_REJECT_VERSION);
+        TRACE_WARN(TRACE_RX_REJECT, (uint32_t)len, REJECT_REASON_VERSION);
+        return WIRE_INVALID;
+    }
+    if (h.group != groupId) {
+        metricInc(METRIC_REJECT_GROUP);
+        return WIRE_INVALID;
+    }
+    if (h.crc != frameCrc(frame, frame + WIRE_HEADER_LEN, len - WIRE_HEADER_LEN)) {
+        metricInc(METRIC_REJECT_CRC);
+        TRACE_WARN(TRACE_RX_REJECT, (uint32_t)len, REJECT_REASON_CRC);
+        return WIRE_INVALID;
+    }
+    if (h.type == WIRE_INVALID || h.type >= WIRE_TYPE_COUNT) {
+        metricInc(METRIC_REJECT_TYPE);
+        return WIRE_INVALID;
+    }
+    *body = frame + WIRE_HEADER_LEN;
+    *bodyLen = len - WIRE_HEADER_LEN;
+    return (WireType)h.type;
+}
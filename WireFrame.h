@@ -0,0 +1,58 @@
+// WireFrame.h
+#ifndef WIRE_FRAME_H
+#define WIRE_FRAME_H
+
+#include <stdint.h>
+#include "TxQueue.h"
+
+// Every frame we send starts with this header. Receivers check it before the
+// body reaches any parser, cheapest test first: length, magic, version, group,
+// then a CRC32 over the header and body. Frames from other ESP-NOW devices or
+// from another party's boards are dropped there and only bump a counter.
+#define WIRE_MAGIC0 'H'
+#define WIRE_MAGIC1 'B'
+#define WIRE_VERSION 2 // 2: seen records grew to two body slots
+// Boards only hear boards in the same group. Every board starts in this one;
+// a party picks its own with the console "group" command, kept in NVS, and
+// boards pair only once they share it.
+#define WIRE_GROUP_NAME "HikingBoard"
+#define WIRE_GROUP_NAME_MAX 15
+
+enum WireType : uint8_t {
+    WIRE_INVALID = 0, // Returned by wireOpen for rejected frames
+    WIRE_STATE = 1,   // 7-byte status records, self first (broadcast and urgent unicast)
+    WIRE_PAIRING = 2, // PairingFrame
+    WIRE_ROSTER = 3,  // RosterFrameHeader + entries
+    WIRE_TYPE_COUNT
+};
+
+struct __attribute__((packed)) WireHeader {
+    uint8_t magic[2];
+    uint8_t version;
+    uint8_t type;    // WireType
+    uint16_t group;  // wireGroupId() of the sender's group name
+    uint32_t crc;    // CRC32 (little endian) of the header up to here, then the body
+};
+
+#define WIRE_HEADER_LEN ((int)sizeof(WireHeader))
+#define WIRE_BODY_MAX (TX_FRAME_MAX - WIRE_HEADER_LEN)
+
+// FNV-1a folded to 16 bits
+constexpr uint16_t wireGroupId(const char* name, uint32_t h = 2166136261u) {
+    return *name ? wireGroupId(name + 1, (h ^ (uint8_t)*name) * 16777619u) : (uint16_t)(h ^ (h >> 16));
+}
+
+// Load the group kept in NVS, or the default; call once at setup
+void wireSetup();
+// Switch to the group with this name and keep it across reboots; "" restores
+// WIRE_GROUP_NAME. Returns false for a name longer than WIRE_GROUP_NAME_MAX.
+bool wireSetGroup(const char* name);
+uint16_t wireGroup();
+
+// Fill in the header of a frame whose body is already at frame + WIRE_HEADER_LEN;
+// returns the frame length
+int wireSeal(uint8_t* frame, WireType type, int bodyLen);
+// Check a received frame; returns its type and body, or WIRE_INVALID
+WireType wireOpen(const uint8_t* frame, int len, const uint8_t** body, int* bodyLen);
+
+#endif // WIRE_FRAME_H
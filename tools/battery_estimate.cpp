@@ -0,0 +1,93 @@
+// Host-side battery life estimator built on the firmware's EnergyModel.h.
+//
+// Build: g++ -std=c++17 -O2 -I.. battery_estimate.cpp -o battery_estimate
+//
+// Usage:
+//   battery_estimate [--interval MS] [--frame BYTES] [--active US] [--sleep] [--battery MAH]
+//       Model a fixed broadcast schedule.
+//   battery_estimate --duty PERIOD_MS:WINDOW_MS [--frame BYTES] [--active US] [--battery MAH]
+//       Model synchronized duty cycling (USE_DUTY_CYCLE).
+//   battery_estimate --report "energy active_us=... idle_us=..." [--battery MAH]
+//       Project the life of a unit from the line printed by its "energy" command.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "EnergyModel.h"
+
+static bool parseReport(const char* line, EnergyAccount& acc) {
+    bool any = false;
+    for (int s = 0; s < POWER_STATE_COUNT; ++s) {
+        std::string key = std::string(POWER_STATE_NAMES[s]) + "_us=";
+        const char* p = strstr(line, key.c_str());
+        if (!p) continue;
+        acc.stateUs[s] = strtoull(p + key.size(), nullptr, 10);
+        any = true;
+    }
+    const char* p = strstr(line, "tx_frames=");
+    if (p) acc.txFrames = (uint32_t)strtoul(p + 10, nullptr, 10);
+    return any;
+}
+
+static void printAccount(const EnergyAccount& acc, double batteryMah) {
+    uint64_t total = energyTotalUs(acc);
+    for (int s = 0; s < POWER_STATE_COUNT; ++s) {
+        double share = total ? 100.0 * (double)acc.stateUs[s] / (double)total : 0.0;
+        printf("%-6s %12llu us %6.2f%%\n", POWER_STATE_NAMES[s], (unsigned long long)acc.stateUs[s], share);
+    }
+    double avgMa = energyAverageCurrentMa(acc);
+    double hours = energyBatteryLifeHours(avgMa, batteryMah);
+    printf("avg_ma=%.2f life_h=%.1f life_days=%.2f battery_mah=%.0f\n", avgMa, hours, hours / 24.0, batteryMah);
+}
+
+int main(int argc, char** argv) {
+    uint32_t intervalMs = 750;
+    uint32_t frameBytes = 122; // Wire header, self state and a full carry list
+    uint32_t activeUs = 4000;  // CPU time per wakeup, including the send
+    bool lightSleep = false;
+    double batteryMah = 2000;
+    const char* report = nullptr;
+    uint32_t dutyPeriodMs = 0;
+    uint32_t dutyWindowMs = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--interval") && i + 1 < argc) intervalMs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--frame") && i + 1 < argc) frameBytes = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--active") && i + 1 < argc) activeUs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--battery") && i + 1 < argc) batteryMah = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--report") && i + 1 < argc) report = argv[++i];
+        else if (!strcmp(argv[i], "--sleep")) lightSleep = true;
+        else if (!strcmp(argv[i], "--duty") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u:%u", &dutyPeriodMs, &dutyWindowMs) != 2 || dutyPeriodMs == 0) {
+                fprintf(stderr, "--duty expects PERIOD_MS:WINDOW_MS\n");
+                return 2;
+            }
+        }
+        else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    EnergyAccount acc;
+    if (report) {
+        if (!parseReport(report, acc)) {
+            fprintf(stderr, "no energy fields found in report\n");
+            return 1;
+        }
+    } else if (dutyPeriodMs) {
+        acc = energyModelDutyCycle(dutyPeriodMs, dutyWindowMs, (uint16_t)frameBytes, activeUs);
+        printf("duty period_ms=%u window_ms=%u frame_bytes=%u active_us=%u\n",
+               dutyPeriodMs, dutyWindowMs, frameBytes, activeUs);
+    } else {
+        if (intervalMs == 0) {
+            fprintf(stderr, "interval must be positive\n");
+            return 2;
+        }
+        acc = energyModelSchedule(intervalMs, (uint16_t)frameBytes, activeUs, lightSleep);
+        printf("schedule interval_ms=%u frame_bytes=%u active_us=%u sleep=%d\n",
+               intervalMs, frameBytes, activeUs, lightSleep ? 1 : 0);
+    }
+    printAccount(acc, batteryMah);
+    return 0;
+}
@@ -0,0 +1,280 @@
+// Host-side microbenchmarks for the protocol hot paths, built against the
+// firmware sources and the tools/host/ shim (in-memory NVS, virtual clock).
+//
+// Build (from tools/, the shim directory must come first):
+//   g++ -std=c++17 -O2 -Ihost -I.. bench.cpp host/HostShim.cpp
+//       ../Communication.cpp ../Device.cpp ../Inbox.cpp ../Utility.cpp
+//       ../Metrics.cpp ../Trace.cpp ../Capture.cpp ../TxQueue.cpp ../UrgentDelivery.cpp
+//       ../DutyCycle.cpp ../Pairing.cpp ../Roster.cpp ../ShortText.cpp ../WireFrame.cpp
+//       ../RxLimit.cpp ../SeenMap.cpp ../Gateway.cpp ../Custody.cpp
+//       ../Route.cpp ../Profile.cpp -o bench
+//
+// Usage:
+//   bench [--filter NAME] [--quick]
+//       Prints one JSON object per line: a schema line, then one line per case with
+//       its parameters, iteration count and the min / median nanoseconds per op over
+//       BATCHES timed batches. Case order and keys are stable so runs can be diffed.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HostShim.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Inbox.h"
+#include "TxQueue.h"
+#include "WireFrame.h"
+
+#define BENCH_SCHEMA 1
+#define BATCHES 5
+#define BENCH_START_US (60ULL * 60 * 1000000) // One hour of uptime
+
+static const char* filter = nullptr;
+static double minBatchNs = 20e6; // Calibrate iterations so a batch takes at least this long
+
+static void makeMac(uint8_t* mac, int i) {
+    const uint8_t base[MAC_SIZE] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x00};
+    memcpy(mac, base, MAC_SIZE);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+// The inbox skips a repeat within the same minute, so cases that measure real
+// updates step the virtual clock one minute per iteration
+static void setMinute(uint64_t i) {
+    hostSetTimeUs(BENCH_START_US + i * 60ULL * 1000000);
+}
+
+// Reset the clock and the global device to the given peer list, inbox fill and
+// carry fill. Peers are makeMac(0..peers-1); carry senders follow on from 1000.
+static void setupDevice(int peers, int inboxFill, int carryFill) {
+    hostSetTimeUs(BENCH_START_US);
+    device.clearPeerList();
+    device.clearCarryMsg();
+    for (int i = 0; i < peers; ++i) {
+        uint8_t mac[MAC_SIZE];
+        makeMac(mac, i);
+        char initials[3];
+        snprintf(initials, sizeof(initials), "%c%c", 'A' + i % 26, 'A' + i / 26 % 26);
+        device.addPeer(mac, initials);
+    }
+    // Entries are unique per (sender, code), spread them over peers and codes
+    for (int n = 0; peers > 0 && n < inboxFill; ++n) {
+        MessageStruct m;
+        makeMac(m.sender, n % peers);
+        m.code = (uint8_t)(n / peers % 10);
+        device.addOrUpdateInboxIfPeer(m);
+    }
+    for (int n = 0; n < carryFill; ++n) {
+        MessageStruct m;
+        makeMac(m.sender, 1000 + n);
+        m.code = 1;
+        device.addOrUpdateCarryMsg(m);
+    }
+}
+
+struct Param {
+    const char* key;
+    long value;
+};
+
+template <class Op>
+static void run(const char* name, std::vector<Param> params, Op op) {
+    if (filter && strcmp(filter, name) != 0) return;
+    using Clock = std::chrono::steady_clock;
+    auto timeBatch = [&](uint64_t iters) {
+        Clock::time_point t0 = Clock::now();
+        for (uint64_t i = 0; i < iters; ++i) op(i);
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    };
+    uint64_t iters = 1;
+    while (timeBatch(iters) < minBatchNs && iters < (1ULL << 30)) iters *= 2;
+    std::vector<double> perOp;
+    for (int b = 0; b < BATCHES; ++b) perOp.push_back(timeBatch(iters) / (double)iters);
+    std::sort(perOp.begin(), perOp.end());
+
+    printf("{\"bench\":\"%s\"", name);
+    for (const Param& p : params) printf(",\"%s\":%ld", p.key, p.value);
+    printf(",\"inbox_after\":%u,\"iterations\":%llu,\"ns_min\":%.1f,\"ns_median\":%.1f}\n",
+           (unsigned)device.getInbox().size(), (unsigned long long)iters, perOp[0], perOp[BATCHES / 2]);
+    fflush(stdout);
+}
+
+static volatile size_t sink;
+
+// A frame of `records` records: the sender first, then a mix of peers and strangers
+static std::vector<uint8_t> buildFrame(int records, int peers, uint8_t code) {
+    std::vector<uint8_t> frame;
+    for (int r = 0; r < records; ++r) {
+        uint8_t mac[MAC_SIZE];
+        makeMac(mac, (r % 2 == 0 && peers > 0) ? r / 2 % peers : 2000 + r);
+        frame.insert(frame.end(), mac, mac + MAC_SIZE);
+        frame.push_back(code);
+    }
+    return frame;
+}
+
+static void benchParse() {
+    const int recordCounts[] = {1, 5, 15, 35};
+    const int peerCounts[] = {0, 8, 32};
+    for (int peers : peerCounts) {
+        for (int records : recordCounts) {
+            setupDevice(peers, 0, 0);
+            // Alternate codes and step the minute so every peer record is a real
+            // refresh (new time, reordered history), not the same-minute early return
+            std::vector<uint8_t> a = buildFrame(records, peers, 1);
+            std::vector<uint8_t> b = buildFrame(records, peers, 2);
+            run("parse", {{"records", records}, {"peers", peers}}, [&](uint64_t i) {
+                const std::vector<uint8_t>& f = (i & 1) ? b : a;
+                setMinute(i);
+                ParseMessages(f.data(), (int)f.size());
+            });
+        }
+    }
+}
+
+// Header checks on a receive: a valid state frame, and the early rejects a
+// foreign device or another group's boards cost
+static void benchWire() {
+    const int recordCounts[] = {1, 15, 35};
+    const uint8_t* body;
+    int bodyLen;
+    for (int records : recordCounts) {
+        std::vector<uint8_t> frame(WIRE_HEADER_LEN);
+        std::vector<uint8_t> b = buildFrame(records, 0, 1);
+        frame.insert(frame.end(), b.begin(), b.end());
+        wireSeal(frame.data(), WIRE_STATE, (int)b.size());
+        run("wire_open", {{"records", records}}, [&](uint64_t) {
+            sink = wireOpen(frame.data(), (int)frame.size(), &body, &bodyLen);
+        });
+        std::vector<uint8_t> foreignGroup = frame;
+        foreignGroup[offsetof(WireHeader, group)] ^= 0xFF;
+        run("wire_reject_group", {{"records", records}}, [&](uint64_t) {
+            sink = wireOpen(foreignGroup.data(), (int)foreignGroup.size(), &body, &bodyLen);
+        });
+        run("wire_reject_magic", {{"records", records}}, [&](uint64_t) {
+            sink = wireOpen(b.data(), (int)b.size(), &body, &bodyLen);
+        });
+    }
+}
+
+static void benchBroadcast() {
+    const int carryCounts[] = {0, 5, CARRY_LIMIT};
+    for (int carry : carryCounts) {
+        setupDevice(8, 0, carry);
+        run("broadcast", {{"carry", carry}}, [&](uint64_t) {
+            broadcastMessages();
+            txOnSendComplete(); // Hand the send credit back as the driver would
+        });
+    }
+}
+
+static void benchCarry() {
+    const int carryCounts[] = {0, 8, CARRY_LIMIT};
+    for (int carry : carryCounts) {
+        setupDevice(0, 0, carry);
+        MessageStruct known, fresh;
+        makeMac(known.sender, 1000 + (carry > 0 ? carry - 1 : 0));
+        known.code = 2;
+        run("carry_update", {{"carry", carry}}, [&](uint64_t i) {
+            known.code = (uint8_t)(1 + (i & 1));
+            device.addOrUpdateCarryMsg(known);
+        });
+        setupDevice(0, 0, carry);
+        // New senders each time: exercises the eviction path once the list is full
+        run("carry_insert", {{"carry", carry}}, [&](uint64_t i) {
+            makeMac(fresh.sender, 3000 + (int)(i % 4096));
+            fresh.code = 1;
+            device.addOrUpdateCarryMsg(fresh);
+        });
+    }
+}
+
+static void benchInbox() {
+    const int peerCounts[] = {1, 8, 32};
+    const int inboxFills[] = {0, 16, INBOX_LIMIT};
+    for (int peers : peerCounts) {
+        for (int fill : inboxFills) {
+            setupDevice(peers, fill, 0);
+            MessageStruct m;
+            makeMac(m.sender, peers - 1);
+            // A real refresh each time: new minute, and the other code leads the history
+            run("inbox_update", {{"peers", peers}, {"inbox", fill}}, [&](uint64_t i) {
+                m.code = (uint8_t)(1 + (i & 1));
+                setMinute(i);
+                device.addOrUpdateInboxIfPeer(m);
+            });
+            setupDevice(peers, fill, 0);
+            // New (sender, code) pairs each time: an insert, and an eviction once full.
+            // Codes 10..89 share one severity and cycle through more pairs than the
+            // inbox holds, so a pair has always been evicted before it comes round again.
+            run("inbox_insert", {{"peers", peers}, {"inbox", fill}}, [&](uint64_t i) {
+                makeMac(m.sender, (int)(i % peers));
+                m.code = (uint8_t)(10 + i / peers % 80);
+                setMinute(i);
+                device.addOrUpdateInboxIfPeer(m);
+            });
+            setupDevice(peers, fill, 0);
+            MessageStruct stranger;
+            makeMac(stranger.sender, 5000);
+            stranger.code = 1;
+            run("inbox_nonpeer", {{"peers", peers}, {"inbox", fill}}, [&](uint64_t) {
+                device.addOrUpdateInboxIfPeer(stranger);
+            });
+        }
+    }
+}
+
+static void benchLookup() {
+    const int peerCounts[] = {1, 8, 32, 64};
+    for (int peers : peerCounts) {
+        setupDevice(peers, 0, 0);
+        uint8_t last[MAC_SIZE], stranger[MAC_SIZE];
+        makeMac(last, peers - 1);
+        makeMac(stranger, 5000);
+        run("is_peer_hit", {{"peers", peers}}, [&](uint64_t) { sink = device.isPeer(last); });
+        run("is_peer_miss", {{"peers", peers}}, [&](uint64_t) { sink = device.isPeer(stranger); });
+        char initials[INITIALS_LEN];
+        run("initials_hit", {{"peers", peers}}, [&](uint64_t) { sink = device.MACToInitials(last, initials)[0]; });
+        run("initials_miss", {{"peers", peers}}, [&](uint64_t) { sink = device.MACToInitials(stranger, initials)[0]; });
+    }
+}
+
+static void benchNvs() {
+    const int peerCounts[] = {1, 16, 64};
+    const int inboxFills[] = {0, INBOX_LIMIT};
+    for (int peers : peerCounts) {
+        for (int fill : inboxFills) {
+            setupDevice(peers, fill, 0);
+            run("nvs_save", {{"peers", peers}, {"inbox", fill}}, [&](uint64_t) { device.saveToNVS(); });
+            run("nvs_load", {{"peers", peers}, {"inbox", fill}}, [&](uint64_t) { device.loadFromNVS(); });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+        else if (!strcmp(argv[i], "--quick")) minBatchNs = 1e6;
+        else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    const uint8_t self[MAC_SIZE] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    hostSetMac(self);
+    device.setMACAddress(self);
+    hostSetTimeUs(BENCH_START_US);
+
+    printf("{\"schema\":%d,\"suite\":\"hikingboard\",\"batches\":%d}\n", BENCH_SCHEMA, BATCHES);
+    benchParse();
+    benchWire();
+    benchBroadcast();
+    benchCarry();
+    benchInbox();
+    benchLookup();
+    benchNvs();
+    return 0;
+}
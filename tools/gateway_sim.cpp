@@ -0,0 +1,161 @@
+// Stand-in for a GATEWAY_MODE board: opens a pseudo-terminal and writes a
+// synthetic gateway stream to it, so tools/gatewayd can be run and loaded
+// without hardware.
+//
+// Build: g++ -std=c++17 -O2 -I.. gateway_sim.cpp -o gateway_sim
+//
+// Usage:
+//   gateway_sim [--rate RECORDS_PER_S] [--hikers N] [--seconds S] [--noise] [--seed N]
+//       Prints the pty path on the first line of stdout, then streams until
+//       S seconds have passed (default: until killed). Each simulated frame
+//       is one hiker's own state plus a few carried records of others.
+//       --noise mixes console text and corrupted frames into the stream.
+//       On exit the final state of every hiker is printed, one per line, in
+//       the format gatewayd's "origin" query can be checked against.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include "GatewayFormat.h"
+
+static const char* const TEXTS[] = {"WATER AT CAMP 2", "MEET AT THE BRIDGE", "SLOW GOING", "BACK IN 20 MINUTES"};
+
+static volatile sig_atomic_t stopping = 0;
+static void onSignal(int) { stopping = 1; }
+
+static void hikerMac(uint8_t* mac, int i) {
+    const uint8_t base[6] = {0x02, 0x47, 0x57, 0x00, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+int main(int argc, char** argv) {
+    double rate = 1000;
+    int hikers = 12;
+    double seconds = 0;
+    bool noise = false;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--rate") && i + 1 < argc) rate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--hikers") && i + 1 < argc) hikers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--noise")) noise = true;
+        else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (rate <= 0 || hikers < 1 || hikers > 65535) {
+        fprintf(stderr, "rate must be positive and hikers 1..65535\n");
+        return 2;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char* slavePath = ptsname(master);
+    // Hold the slave open in raw mode so the stream passes through untouched
+    // and writes don't fail before the daemon has opened it
+    int slave = open(slavePath, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    printf("%s\n", slavePath);
+    fflush(stdout);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> codes(hikers, 0);
+    std::vector<uint8_t> frame(GATEWAY_MAX_FRAME);
+    std::string out;
+    uint64_t records = 0;
+    const uint8_t gatewayMac[6] = {0x02, 0x47, 0x57, 0xFF, 0xFF, 0xFF};
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point lastHello = start - std::chrono::seconds(10);
+    while (!stopping) {
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds > 0 && elapsed >= seconds) break;
+        uint32_t boardMs = (uint32_t)(elapsed * 1000);
+        out.clear();
+        if (Clock::now() - lastHello >= std::chrono::seconds(5)) {
+            GatewayHello hello = {};
+            memcpy(hello.mac, gatewayMac, 6);
+            hello.version = GATEWAY_VERSION;
+            hello.uptimeMs = boardMs;
+            unsigned n = gatewayEncode(GATEWAY_HELLO, &hello, sizeof(hello), frame.data());
+            out.append((const char*)frame.data(), n);
+            lastHello = Clock::now();
+        }
+        // Emit what is due by now, in whole simulated frames
+        uint64_t due = (uint64_t)(elapsed * rate);
+        while (records < due) {
+            int relay = (int)(rng() % hikers);
+            if (rng() % 20 == 0) codes[relay] = (uint8_t)(rng() % 10);
+            int carried = hikers > 1 ? (int)(rng() % 6) : 0;
+            for (int r = 0; r <= carried; ++r) {
+                int origin = r == 0 ? relay : (int)(rng() % hikers);
+                if (r > 0 && origin == relay) continue;
+                GatewayRecord rec;
+                rec.timeMs = boardMs;
+                hikerMac(rec.relay, relay);
+                hikerMac(rec.origin, origin);
+                rec.code = codes[origin];
+                rec.rssi = (int8_t)(-40 - (int)(rng() % 50));
+                rec.index = (uint8_t)r;
+                unsigned n = gatewayEncode(GATEWAY_RECORD, &rec, sizeof(rec), frame.data());
+                out.append((const char*)frame.data(), n);
+                records++;
+            }
+            if (rng() % 200 == 0) {
+                uint8_t payload[GATEWAY_MAX_PAYLOAD];
+                GatewayText head;
+                head.timeMs = boardMs;
+                hikerMac(head.origin, relay);
+                memcpy(payload, &head, sizeof(head));
+                const char* text = TEXTS[rng() % (sizeof(TEXTS) / sizeof(TEXTS[0]))];
+                memcpy(payload + sizeof(head), text, strlen(text));
+                unsigned n = gatewayEncode(GATEWAY_TEXT, payload, sizeof(head) + strlen(text), frame.data());
+                out.append((const char*)frame.data(), n);
+            }
+            if (noise && rng() % 50 == 0) {
+                out += "console output mixed into the stream\r\n";
+                // A frame with a flipped bit must be rejected by its CRC
+                GatewayRecord junk = {};
+                unsigned n = gatewayEncode(GATEWAY_RECORD, &junk, sizeof(junk), frame.data());
+                frame[6] ^= 0x10;
+                out.append((const char*)frame.data(), n);
+            }
+        }
+        if (!out.empty() && write(master, out.data(), out.size()) < 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // Let the reader drain the pty before it goes away
+    tcdrain(master);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    fprintf(stderr, "records=%llu\n", (unsigned long long)records);
+    for (int i = 0; i < hikers; ++i) {
+        uint8_t mac[6];
+        hikerMac(mac, i);
+        printf("%02X:%02X:%02X:%02X:%02X:%02X code=%u\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], codes[i]);
+    }
+    close(slave);
+    close(master);
+    return 0;
+}
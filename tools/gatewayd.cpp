@@ -0,0 +1,426 @@
+// Linux daemon for a board built with GATEWAY_MODE (Gateway.h): reads its
+// serial stream, keeps a live state table of the whole group and answers
+// queries on a unix socket.
+//
+// Build (from tools/): g++ -std=c++17 -O2 -Ihost -I.. gatewayd.cpp -o gatewayd
+//
+// Usage:
+//   gatewayd DEVICE [--baud N] [--socket PATH] [--stats SECONDS]
+//       Read the stream from DEVICE (the board's serial port, or the pty printed
+//       by gateway_sim) and serve queries on PATH (default /tmp/gatewayd.sock).
+//       --stats prints the stream counters every SECONDS to stdout.
+//   gatewayd --query PATH COMMAND...
+//       Send one query and print the reply.
+//
+// Queries are one line each and get one JSON line back:
+//   state        every origin heard: code, age, via which relay, rssi, text
+//   origin MAC   one origin
+//   relays       every board heard directly: frames, rssi, age
+//   stats        stream counters and the gateway's own hello
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+#include "GatewayFormat.h"
+#include "Message.h"
+
+// A relayed record may be older than what the origin itself said last
+static const uint64_t RELAYED_DEFER_MS = 10000;
+
+static uint64_t nowMs() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t macKey(const uint8_t* mac) {
+    uint64_t k = 0;
+    for (int i = 0; i < 6; ++i) k = k << 8 | mac[i];
+    return k;
+}
+
+static std::string macString(uint64_t k) {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", (unsigned)(k >> 40 & 0xFF), (unsigned)(k >> 32 & 0xFF),
+             (unsigned)(k >> 24 & 0xFF), (unsigned)(k >> 16 & 0xFF), (unsigned)(k >> 8 & 0xFF), (unsigned)(k & 0xFF));
+    return buf;
+}
+
+static bool parseMac(const char* s, uint64_t& k) {
+    unsigned b[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) return false;
+    k = 0;
+    for (int i = 0; i < 6; ++i) k = k << 8 | (b[i] & 0xFF);
+    return true;
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+// --- State table ---
+
+struct OriginState {
+    uint8_t code = 0;
+    uint64_t heardMs = 0;      // Host time of the last accepted record
+    uint64_t directMs = 0;     // Host time the origin itself last reported
+    uint64_t via = 0;          // Relay of the last accepted record
+    int8_t rssi = 0;
+    uint64_t updates = 0;      // Records about this origin, accepted or not
+    std::string text;
+    uint64_t textMs = 0;
+};
+
+struct RelayState {
+    uint64_t frames = 0;
+    int8_t rssi = 0;
+    uint64_t heardMs = 0;
+};
+
+struct Stats {
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    uint64_t records = 0;
+    uint64_t texts = 0;
+    uint64_t hellos = 0;
+    uint64_t crcErrors = 0;
+    uint64_t skipped = 0;      // Bytes outside any frame: console text and noise
+    uint64_t gateway = 0;      // From the last hello
+    uint32_t gatewayUptimeMs = 0;
+    uint32_t gatewayDrops = 0;
+};
+
+static std::unordered_map<uint64_t, OriginState> origins;
+static std::unordered_map<uint64_t, RelayState> relays;
+static Stats stats;
+
+static void onRecord(const GatewayRecord& r, uint64_t now) {
+    uint64_t origin = macKey(r.origin);
+    uint64_t relay = macKey(r.relay);
+    stats.records++;
+    if (r.index == 0) {
+        RelayState& rs = relays[relay];
+        rs.frames++;
+        rs.rssi = r.rssi;
+        rs.heardMs = now;
+    }
+    if (r.code == SYNC_CODE) return; // Duty-cycle beacon, not a state
+    OriginState& o = origins[origin];
+    o.updates++;
+    bool direct = origin == relay;
+    if (!direct && o.directMs && now - o.directMs < RELAYED_DEFER_MS) return;
+    o.code = r.code;
+    o.heardMs = now;
+    o.via = relay;
+    o.rssi = r.rssi;
+    if (direct) o.directMs = now;
+}
+
+static void onFrame(uint8_t type, const uint8_t* payload, unsigned len, uint64_t now) {
+    stats.frames++;
+    if (type == GATEWAY_RECORD && len == sizeof(GatewayRecord)) {
+        GatewayRecord r;
+        memcpy(&r, payload, sizeof(r));
+        onRecord(r, now);
+    } else if (type == GATEWAY_TEXT && len >= sizeof(GatewayText)) {
+        GatewayText t;
+        memcpy(&t, payload, sizeof(t));
+        OriginState& o = origins[macKey(t.origin)];
+        o.text.assign((const char*)payload + sizeof(t), len - sizeof(t));
+        o.textMs = now;
+        stats.texts++;
+    } else if (type == GATEWAY_HELLO && len == sizeof(GatewayHello)) {
+        GatewayHello h;
+        memcpy(&h, payload, sizeof(h));
+        stats.hellos++;
+        stats.gateway = macKey(h.mac);
+        stats.gatewayUptimeMs = h.uptimeMs;
+        stats.gatewayDrops = h.drops;
+    }
+}
+
+// --- Stream parser ---
+
+static std::vector<uint8_t> pending;
+
+static void feed(const uint8_t* data, size_t n, uint64_t now) {
+    stats.bytes += n;
+    pending.insert(pending.end(), data, data + n);
+    size_t pos = 0;
+    while (pending.size() - pos >= 4) {
+        const uint8_t* p = pending.data() + pos;
+        if (p[0] != GATEWAY_SYNC0 || p[1] != GATEWAY_SYNC1 || p[3] > GATEWAY_MAX_PAYLOAD) {
+            pos++;
+            stats.skipped++;
+            continue;
+        }
+        unsigned len = p[3];
+        if (pending.size() - pos < len + GATEWAY_FRAME_OVERHEAD) break; // Wait for the rest
+        uint16_t crc = (uint16_t)(p[4 + len] | p[5 + len] << 8);
+        if (gatewayCrc16(p + 2, len + 2) != crc) {
+            // A false sync inside text or noise; rescan from the next byte
+            stats.crcErrors++;
+            pos++;
+            stats.skipped++;
+            continue;
+        }
+        onFrame(p[2], p + 4, len, now);
+        pos += len + GATEWAY_FRAME_OVERHEAD;
+    }
+    pending.erase(pending.begin(), pending.begin() + pos);
+}
+
+// --- Queries ---
+
+static std::string originJson(uint64_t key, const OriginState& o, uint64_t now) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"origin\":\"%s\",\"code\":%u,\"state\":%s,\"age_ms\":%llu,\"via\":\"%s\",\"direct\":%s,"
+             "\"rssi\":%d,\"updates\":%llu",
+             macString(key).c_str(), o.code, jsonString(MessageMapping(o.code)).c_str(),
+             (unsigned long long)(o.heardMs ? now - o.heardMs : 0), macString(o.via).c_str(),
+             o.via == key ? "true" : "false", o.rssi, (unsigned long long)o.updates);
+    std::string out = buf;
+    if (o.textMs) {
+        snprintf(buf, sizeof(buf), ",\"text_age_ms\":%llu", (unsigned long long)(now - o.textMs));
+        out += ",\"text\":" + jsonString(o.text) + buf;
+    }
+    return out + "}";
+}
+
+static std::string query(const std::string& line) {
+    uint64_t now = nowMs();
+    char buf[512];
+    if (line == "state") {
+        std::string out = "{\"origins\":[";
+        bool first = true;
+        for (const auto& kv : origins) {
+            if (!kv.second.heardMs && !kv.second.textMs) continue;
+            if (!first) out += ",";
+            out += originJson(kv.first, kv.second, now);
+            first = false;
+        }
+        return out + "]}";
+    }
+    if (line.compare(0, 7, "origin ") == 0) {
+        uint64_t key;
+        if (!parseMac(line.c_str() + 7, key)) return "{\"error\":\"bad mac\"}";
+        auto it = origins.find(key);
+        if (it == origins.end()) return "{\"error\":\"unknown origin\"}";
+        return originJson(it->first, it->second, now);
+    }
+    if (line == "relays") {
+        std::string out = "{\"relays\":[";
+        bool first = true;
+        for (const auto& kv : relays) {
+            snprintf(buf, sizeof(buf), "%s{\"relay\":\"%s\",\"frames\":%llu,\"rssi\":%d,\"age_ms\":%llu}",
+                     first ? "" : ",", macString(kv.first).c_str(), (unsigned long long)kv.second.frames,
+                     kv.second.rssi, (unsigned long long)(now - kv.second.heardMs));
+            out += buf;
+            first = false;
+        }
+        return out + "]}";
+    }
+    if (line == "stats") {
+        snprintf(buf, sizeof(buf),
+                 "{\"bytes\":%llu,\"frames\":%llu,\"records\":%llu,\"texts\":%llu,\"hellos\":%llu,"
+                 "\"crc_errors\":%llu,\"skipped_bytes\":%llu,\"origins\":%zu,\"relays\":%zu,"
+                 "\"gateway\":\"%s\",\"gateway_uptime_ms\":%u,\"gateway_drops\":%u}",
+                 (unsigned long long)stats.bytes, (unsigned long long)stats.frames,
+                 (unsigned long long)stats.records, (unsigned long long)stats.texts,
+                 (unsigned long long)stats.hellos, (unsigned long long)stats.crcErrors,
+                 (unsigned long long)stats.skipped, origins.size(), relays.size(),
+                 macString(stats.gateway).c_str(), stats.gatewayUptimeMs, stats.gatewayDrops);
+        return buf;
+    }
+    return "{\"error\":\"unknown query\"}";
+}
+
+// --- I/O ---
+
+static speed_t baudConstant(long baud) {
+    switch (baud) {
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+    }
+    return 0;
+}
+
+static int openDevice(const char* path, long baud) {
+    int fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (isatty(fd)) {
+        // Binary stream: no line discipline, no echo, no CR/LF translation
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        speed_t speed = baudConstant(baud);
+        if (speed) {
+            cfsetispeed(&tio, speed);
+            cfsetospeed(&tio, speed);
+        }
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static int listenSocket(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+static int runQuery(const char* path, const std::string& command) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        return 1;
+    }
+    std::string line = command + "\n";
+    if (write(fd, line.data(), line.size()) != (ssize_t)line.size()) return 1;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, n, stdout);
+        if (buf[n - 1] == '\n') break;
+    }
+    close(fd);
+    return 0;
+}
+
+struct Client {
+    int fd;
+    std::string in;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static void onSignal(int) { stopping = 1; }
+
+int main(int argc, char** argv) {
+    const char* device = nullptr;
+    const char* socketPath = "/tmp/gatewayd.sock";
+    long baud = 921600;
+    int statsSeconds = 0;
+
+    if (argc >= 4 && !strcmp(argv[1], "--query")) {
+        std::string command = argv[3];
+        for (int i = 4; i < argc; ++i) command += std::string(" ") + argv[i];
+        return runQuery(argv[2], command);
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--baud") && i + 1 < argc) baud = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--socket") && i + 1 < argc) socketPath = argv[++i];
+        else if (!strcmp(argv[i], "--stats") && i + 1 < argc) statsSeconds = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !device) device = argv[i];
+        else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (!device) {
+        fprintf(stderr, "usage: gatewayd DEVICE [--baud N] [--socket PATH] [--stats SECONDS]\n"
+                        "       gatewayd --query PATH COMMAND...\n");
+        return 2;
+    }
+    if (!baudConstant(baud)) {
+        fprintf(stderr, "unsupported baud rate %ld\n", baud);
+        return 2;
+    }
+
+    int devFd = openDevice(device, baud);
+    int listenFd = listenSocket(socketPath);
+    if (devFd < 0 || listenFd < 0) return 1;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Client> clients;
+    uint64_t lastStatsMs = nowMs();
+    uint8_t buf[8192];
+    while (!stopping) {
+        std::vector<struct pollfd> fds;
+        fds.push_back({devFd, POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const Client& c : clients) fds.push_back({c.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), statsSeconds ? 200 : 1000) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t n = read(devFd, buf, sizeof(buf));
+            if (n > 0) feed(buf, (size_t)n, nowMs());
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR)) {
+            // Board unplugged or simulator gone; keep serving what we have
+            usleep(100000);
+        }
+        if (fds[1].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) clients.push_back({fd, ""});
+        }
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            Client& c = clients[i - 2];
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n <= 0) {
+                close(c.fd);
+                c.fd = -1;
+                continue;
+            }
+            c.in.append((const char*)buf, n);
+            size_t nl;
+            while ((nl = c.in.find('\n')) != std::string::npos) {
+                std::string line = c.in.substr(0, nl);
+                c.in.erase(0, nl + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                std::string reply = query(line) + "\n";
+                if (write(c.fd, reply.data(), reply.size()) < 0) break;
+            }
+        }
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (clients[i].fd < 0) clients.erase(clients.begin() + i);
+        }
+        if (statsSeconds && nowMs() - lastStatsMs >= (uint64_t)statsSeconds * 1000) {
+            lastStatsMs = nowMs();
+            printf("%s\n", query("stats").c_str());
+            fflush(stdout);
+        }
+    }
+    for (const Client& c : clients) close(c.fd);
+    close(listenFd);
+    unlink(socketPath);
+    close(devFd);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Host build shim for the subset of the Arduino core the protocol code uses.
+// Lets tools/ compile Communication.cpp, Device.cpp and friends on Linux.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+
+// Virtual clock, driven by the host tool (see HostShim.h)
+unsigned long millis();
+unsigned long micros();
+// Scales esp_cpu_get_cycle_count(), which counts host nanoseconds
+uint32_t getCpuFrequencyMhz();
+
+using std::min;
+using std::max;
+
+class String {
+public:
+    String() {}
+    String(const char* s) : str(s ? s : "") {}
+    const char* c_str() const { return str.c_str(); }
+    unsigned length() const { return (unsigned)str.size(); }
+private:
+    std::string str;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; ++i) write(data[i]);
+        return len;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = 10) { return printNumber((long long)v, base); }
+    size_t print(unsigned v, int base = 10) { return printNumber((long long)v, base); }
+    size_t print(long v, int base = 10) { return printNumber((long long)v, base); }
+    size_t print(unsigned long v, int base = 10) { return printNumber((long long)v, base); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t println() { return print("\r\n"); }
+    template <class T> size_t println(const T& v) { return print(v) + println(); }
+    template <class T> size_t println(const T& v, int arg) { return print(v, arg) + println(); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buf, std::min((size_t)n, sizeof(buf) - 1));
+    }
+private:
+    size_t printNumber(long long v, int base) {
+        char buf[24];
+        if (base == 16) snprintf(buf, sizeof(buf), "%llX", v);
+        else snprintf(buf, sizeof(buf), "%lld", v);
+        return print(buf);
+    }
+};
+
+// Serial goes to stdout
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* data, size_t len) override { return fwrite(data, 1, len, stdout); }
+    int available() { return 0; }
+    int read() { return -1; }
+    int availableForWrite() { return 4096; }
+    void onReceive(void (*)(), bool = false) {}
+    void flush() { fflush(stdout); }
+};
+extern HardwareSerial Serial;
@@ -0,0 +1,164 @@
+#include "HostShim.h"
+#include <Arduino.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_rom_crc.h>
+#include <esp_cpu.h>
+#include <chrono>
+#include <WiFi.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include "Power.h"
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+static uint64_t clockUs = 0;
+static uint8_t hostMac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static HostSendHook sendHook = nullptr;
+static uint32_t sentFrames = 0;
+static uint32_t nvsCommits = 0;
+
+void hostSetTimeUs(uint64_t timeUs) { clockUs = timeUs; }
+uint64_t hostTimeUs() { return clockUs; }
+unsigned long millis() { return (unsigned long)(uint32_t)(clockUs / 1000); }
+unsigned long micros() { return (unsigned long)(uint32_t)clockUs; }
+int64_t esp_timer_get_time() { return (int64_t)clockUs; }
+
+// Real time, not the virtual clock: profiling spans measure the host's own work
+uint32_t esp_cpu_get_cycle_count() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+uint32_t getCpuFrequencyMhz() { return 1000; }
+
+void hostSetMac(const uint8_t* mac) { memcpy(hostMac, mac, 6); }
+void hostSetSendHook(HostSendHook hook) { sendHook = hook; }
+uint32_t hostSentFrames() { return sentFrames; }
+
+// --- ESP-NOW / Wi-Fi ---
+
+esp_err_t esp_now_init() { return ESP_OK; }
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t) { return ESP_OK; }
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t) { return ESP_OK; }
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t*) { return ESP_OK; }
+esp_err_t esp_now_del_peer(const uint8_t*) { return ESP_OK; }
+bool esp_now_is_peer_exist(const uint8_t*) { return true; }
+
+esp_err_t esp_now_send(const uint8_t* mac, const uint8_t* data, size_t len) {
+    sentFrames++;
+    if (sendHook) sendHook(mac, data, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t, uint8_t* mac) {
+    memcpy(mac, hostMac, 6);
+    return ESP_OK;
+}
+esp_err_t esp_wifi_start() { return ESP_OK; }
+esp_err_t esp_wifi_stop() { return ESP_OK; }
+
+// --- ROM CRC ---
+
+// Reflected CRC-32 (0xEDB88320) with inverted in/out, chainable like the ROM version
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len--) crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// --- NVS ---
+// Writes are staged per handle and only become visible on commit, like the real thing
+
+struct NvsHandle {
+    std::string ns;
+    std::map<std::string, std::vector<uint8_t>> staged;
+    std::vector<std::string> erased;
+};
+static std::map<nvs_handle_t, NvsHandle> handles;
+static nvs_handle_t nextHandle = 1;
+
+std::map<std::string, std::vector<uint8_t>>& hostNvs() {
+    // Function-local so it is ready for Device's constructor during static init
+    static std::map<std::string, std::vector<uint8_t>> store;
+    return store;
+}
+uint32_t hostNvsCommits() { return nvsCommits; }
+
+esp_err_t nvs_flash_init() { return ESP_OK; }
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t, nvs_handle_t* handle) {
+    *handle = nextHandle++;
+    handles[*handle].ns = name;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) { handles.erase(handle); }
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    NvsHandle& h = handles[handle];
+    for (const std::string& key : h.erased) hostNvs().erase(key);
+    for (auto& kv : h.staged) hostNvs()[kv.first] = kv.second;
+    h.erased.clear();
+    h.staged.clear();
+    nvsCommits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t len) {
+    NvsHandle& h = handles[handle];
+    const uint8_t* p = (const uint8_t*)value;
+    h.staged[h.ns + "/" + key].assign(p, p + len);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* len) {
+    auto it = hostNvs().find(handles[handle].ns + "/" + key);
+    if (it == hostNvs().end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (out) {
+        if (*len < it->second.size()) return ESP_FAIL;
+        memcpy(out, it->second.data(), it->second.size());
+    }
+    *len = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out) {
+    size_t len = sizeof(*out);
+    return nvs_get_blob(handle, key, out, &len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    NvsHandle& h = handles[handle];
+    std::string full = h.ns + "/" + key;
+    h.staged.erase(full);
+    h.erased.push_back(full);
+    return ESP_OK;
+}
+
+// --- Power hooks (Power.cpp is target only) ---
+
+static EnergyAccount account;
+void powerSetup() {}
+void powerIdle(uint32_t) {}
+void powerWake() {}
+void powerWakeFromISR() {}
+void powerSetRadioOn(bool) {}
+void powerNoteTx(uint16_t payloadBytes) {
+    account.stateUs[POWER_TX] += energyAirtimeUs(payloadBytes);
+    account.txFrames++;
+}
+const EnergyAccount& powerGetAccount() { return account; }
+void powerPrintReport(Print& out) { out.println("energy accounting is target only"); }
@@ -0,0 +1,25 @@
+// Host-side controls for the shim headers in this directory. Link
+// HostShim.cpp with the firmware sources the tool needs (not Power.cpp,
+// ButtonInput.cpp, Display.cpp or Menu.cpp; the power hooks live here).
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Virtual clock read by millis(), micros() and esp_timer_get_time()
+void hostSetTimeUs(uint64_t timeUs);
+uint64_t hostTimeUs();
+
+// Address returned by esp_wifi_get_mac()
+void hostSetMac(const uint8_t* mac);
+
+// Called for every esp_now_send(); nullptr just counts the frame
+typedef void (*HostSendHook)(const uint8_t* dest, const uint8_t* data, size_t len);
+void hostSetSendHook(HostSendHook hook);
+uint32_t hostSentFrames();
+
+// In-memory NVS: committed contents keyed by "namespace/key"
+std::map<std::string, std::vector<uint8_t>>& hostNvs();
+uint32_t hostNvsCommits();
@@ -0,0 +1,6 @@
+// Host build shim
+#pragma once
+#include "esp_wifi.h"
+#define WIFI_STA 1
+class WiFiClass { public: bool mode(int) { return true; } };
+extern WiFiClass WiFi;
@@ -0,0 +1,5 @@
+// Host build shim: the CPU cycle counter reads the host's steady clock in
+// nanoseconds, with getCpuFrequencyMhz() reporting 1000 to match
+#pragma once
+#include <stdint.h>
+uint32_t esp_cpu_get_cycle_count();
@@ -0,0 +1,4 @@
+// Host build shim: the ROM CRC32 as a table-driven software version
+#pragma once
+#include <stdint.h>
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
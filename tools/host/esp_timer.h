@@ -0,0 +1,4 @@
+// Host build shim: esp_timer_get_time() reads the virtual clock
+#pragma once
+#include <stdint.h>
+int64_t esp_timer_get_time();
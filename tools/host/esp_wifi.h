@@ -0,0 +1,6 @@
+// Host build shim
+#pragma once
+#include "esp_now.h"
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t* mac);
+esp_err_t esp_wifi_start();
+esp_err_t esp_wifi_stop();
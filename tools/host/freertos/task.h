@@ -0,0 +1,3 @@
+// Host build shim
+#pragma once
+#include "FreeRTOS.h"
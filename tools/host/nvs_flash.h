@@ -0,0 +1,4 @@
+// Host build shim
+#pragma once
+#include "nvs.h"
+esp_err_t nvs_flash_init();
@@ -0,0 +1,162 @@
+// Host-side replay of a frame capture (the board's "capture" console command,
+// built with USE_FRAME_CAPTURE) through the firmware's receive path.
+//
+// Build (from tools/, the shim directory must come first):
+//   g++ -std=c++17 -O2 -Ihost -I.. replay.cpp host/HostShim.cpp
+//       ../Communication.cpp ../Device.cpp ../Inbox.cpp ../Utility.cpp
+//       ../Metrics.cpp ../Trace.cpp ../Capture.cpp ../TxQueue.cpp ../UrgentDelivery.cpp
+//       ../DutyCycle.cpp ../Pairing.cpp ../Roster.cpp ../ShortText.cpp ../WireFrame.cpp
+//       ../RxLimit.cpp ../SeenMap.cpp ../Gateway.cpp ../Custody.cpp
+//       ../Route.cpp ../Profile.cpp -o replay
+//
+// Usage:
+//   replay CAPTURE.pcap [--speed X | --fast] [--quiet]
+//       Restore the capturing unit's MAC, state and peers from the capture, then
+//       feed every received frame to dataRecvCallback() at its recorded time.
+//       --speed X replays X times faster than real time, --fast does not wait.
+//       Ends with the resulting inbox, the metrics line and the parse cost.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "HostShim.h"
+#include "CaptureFormat.h"
+#include "Communication.h"
+#include "Device.h"
+#include "Message.h"
+#include "Metrics.h"
+
+static bool quiet = false;
+
+static void printMac(const uint8_t* mac) {
+    printf("%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static void restoreInfo(const CapturePseudoHeader& header, const uint8_t* data, uint32_t len) {
+    if (len < sizeof(CaptureInfo)) return;
+    CaptureInfo info;
+    memcpy(&info, data, sizeof(info));
+    hostSetMac(header.mac);
+    device.setMACAddress(header.mac);
+    device.clearPeerList();
+    for (uint8_t i = 0; i < info.peerCount; ++i) {
+        size_t offset = sizeof(info) + i * sizeof(CapturePeer);
+        if (offset + sizeof(CapturePeer) > len) break;
+        CapturePeer p;
+        memcpy(&p, data + offset, sizeof(p));
+        char initials[INITIALS_LEN] = {p.initials[0], p.initials[1], '\0'};
+        device.addPeer(p.mac, initials);
+    }
+    device.setUserState(info.userState);
+    printf("unit ");
+    printMac(header.mac);
+    printf(" state=%u peers=%u\n", info.userState, info.peerCount);
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    double speed = 1.0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--speed") && i + 1 < argc) speed = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--fast")) speed = 0.0;
+        else if (!strcmp(argv[i], "--quiet")) quiet = true;
+        else if (!path && argv[i][0] != '-') path = argv[i];
+        else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (!path || speed < 0.0) {
+        fprintf(stderr, "usage: replay CAPTURE.pcap [--speed X | --fast] [--quiet]\n");
+        return 2;
+    }
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    PcapFileHeader file;
+    if (fread(&file, sizeof(file), 1, in) != 1 || file.magic != CAPTURE_PCAP_MAGIC ||
+        file.linkType != CAPTURE_PCAP_LINKTYPE) {
+        fprintf(stderr, "%s: not a HikingBoard capture\n", path);
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    uint32_t rxFrames = 0, txFrames = 0;
+    uint64_t parseNsTotal = 0, parseNsMax = 0;
+    uint64_t firstUs = 0;
+    bool started = false;
+    Clock::time_point wallStart = Clock::now();
+    PcapRecordHeader rec;
+    std::vector<uint8_t> buf;
+    while (fread(&rec, sizeof(rec), 1, in) == 1) {
+        if (rec.inclLen < sizeof(CapturePseudoHeader) || rec.inclLen > file.snapLen) {
+            fprintf(stderr, "corrupt record, stopping\n");
+            break;
+        }
+        buf.resize(rec.inclLen);
+        if (fread(buf.data(), 1, rec.inclLen, in) != rec.inclLen) break;
+        CapturePseudoHeader header;
+        memcpy(&header, buf.data(), sizeof(header));
+        const uint8_t* data = buf.data() + sizeof(header);
+        uint32_t len = rec.inclLen - sizeof(header);
+        uint64_t timeUs = (uint64_t)rec.tsSec * 1000000ULL + rec.tsUsec;
+
+        if (header.direction == CAPTURE_INFO) {
+            restoreInfo(header, data, len);
+            continue;
+        }
+        if (!started) {
+            firstUs = timeUs;
+            started = true;
+        }
+        if (speed > 0.0 && timeUs >= firstUs) {
+            auto due = wallStart + std::chrono::microseconds((uint64_t)((timeUs - firstUs) / speed));
+            std::this_thread::sleep_until(due);
+        }
+        if (timeUs > hostTimeUs()) hostSetTimeUs(timeUs);
+
+        if (!quiet) {
+            printf("%12.6f %s ", (double)timeUs / 1e6, header.direction == CAPTURE_RX ? "rx" : "tx");
+            printMac(header.mac);
+            printf(" rssi=%d bytes=%u\n", header.rssi, len);
+        }
+        if (header.direction == CAPTURE_TX) {
+            txFrames++;
+            continue;
+        }
+        wifi_pkt_rx_ctrl_t ctrl;
+        ctrl.rssi = header.rssi;
+        esp_now_recv_info_t info;
+        info.src_addr = header.mac;
+        info.des_addr = nullptr;
+        info.rx_ctrl = &ctrl;
+        Clock::time_point t0 = Clock::now();
+        dataRecvCallback(&info, data, (int)len);
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+        parseNsTotal += ns;
+        if (ns > parseNsMax) parseNsMax = ns;
+        rxFrames++;
+        device.flushIfDue(millis());
+    }
+    fclose(in);
+    device.flushIfDue(millis() + NVS_FLUSH_DELAY_MS);
+
+    const Inbox& inbox = device.getInbox();
+    printf("inbox %u entries\n", (unsigned)inbox.size());
+    for (size_t i = 0; i < inbox.size(); ++i) {
+        const InboxRecord& r = inbox.byPriority(i);
+        char initials[INITIALS_LEN];
+        printf("  %s ", device.MACToInitials(r.sender, initials));
+        printMac(r.sender);
+        printf(" %s received_min=%u\n", MessageMapping(r.code), r.receivedMin);
+    }
+    fflush(stdout);
+    metricsPrint(Serial);
+    printf("replay rx_frames=%u tx_frames=%u parse_ns_total=%llu parse_ns_max=%llu nvs_commits=%u\n",
+           rxFrames, txFrames, (unsigned long long)parseNsTotal, (unsigned long long)parseNsMax, hostNvsCommits());
+    return 0;
+}
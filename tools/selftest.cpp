@@ -0,0 +1,132 @@
+// Host-side protocol checks, built against the firmware sources and the
+// tools/host/ shim (in-memory NVS, virtual clock) like bench.
+//
+// Build (from tools/, the shim directory must come first):
+//   g++ -std=c++17 -O2 -Ihost -I.. selftest.cpp host/HostShim.cpp
+//       ../Communication.cpp ../Device.cpp ../Inbox.cpp ../Utility.cpp
+//       ../Metrics.cpp ../Trace.cpp ../Capture.cpp ../TxQueue.cpp ../UrgentDelivery.cpp
+//       ../DutyCycle.cpp ../Pairing.cpp ../Roster.cpp ../ShortText.cpp ../WireFrame.cpp
+//       ../RxLimit.cpp ../SeenMap.cpp ../Gateway.cpp ../Custody.cpp
+//       ../Route.cpp ../Profile.cpp -o selftest
+//
+// Usage:
+//   selftest [--filter NAME]
+//       Prints "ok NAME" or "FAIL NAME: reason" per check and exits non-zero
+//       if any check failed.
+#include <cstdio>
+#include <cstring>
+#include "HostShim.h"
+#include "WireFrame.h"
+#include "Metrics.h"
+#include "Custody.h"
+
+static const char* filter = nullptr;
+static const char* failure = nullptr;
+
+#define CHECK(cond)                                       \
+    do {                                                  \
+        if (!(cond) && !failure) failure = #cond;         \
+    } while (0)
+
+// Boards in different groups drop each other's frames at the header, and a
+// group set from the console survives a reboot
+static void checkWireGroup() {
+    const char* names[2] = {"Smiths", "Joneses"};
+    uint16_t ids[2];
+    uint8_t frames[2][WIRE_HEADER_LEN + 7];
+    for (int g = 0; g < 2; ++g) {
+        CHECK(wireSetGroup(names[g]));
+        ids[g] = wireGroup();
+        memset(frames[g] + WIRE_HEADER_LEN, 0x40 + g, 7);
+        wireSeal(frames[g], WIRE_STATE, 7);
+    }
+    CHECK(ids[0] != ids[1]);
+    CHECK(ids[0] != wireGroupId(WIRE_GROUP_NAME));
+    for (int g = 0; g < 2; ++g) {
+        CHECK(wireSetGroup(names[g]));
+        const uint8_t* body;
+        int bodyLen;
+        uint32_t rejects = metricGet(METRIC_REJECT_GROUP);
+        CHECK(wireOpen(frames[1 - g], sizeof(frames[0]), &body, &bodyLen) == WIRE_INVALID);
+        CHECK(metricGet(METRIC_REJECT_GROUP) == rejects + 1);
+        CHECK(wireOpen(frames[g], sizeof(frames[0]), &body, &bodyLen) == WIRE_STATE);
+    }
+    // The group is what a reboot loads; the default is not stored at all
+    CHECK(wireSetGroup(names[0]));
+    uint32_t stored = 0;
+    auto kept = hostNvs().find("hiking/group");
+    CHECK(kept != hostNvs().end() && kept->second.size() == sizeof(stored));
+    if (kept != hostNvs().end() && kept->second.size() == sizeof(stored)) {
+        memcpy(&stored, kept->second.data(), sizeof(stored));
+    }
+    CHECK(stored == ids[0]);
+    wireSetup();
+    CHECK(wireGroup() == ids[0]);
+    CHECK(!wireSetGroup("a-name-much-too-long"));
+    CHECK(wireGroup() == ids[0]);
+    CHECK(wireSetGroup(""));
+    CHECK(wireGroup() == wireGroupId(WIRE_GROUP_NAME));
+    CHECK(hostNvs().count("hiking/group") == 0);
+}
+
+// The origin reports SOS itself while a stale carry list still relays its
+// earlier INJURED: custody is written once and keeps the origin's code
+static void checkCustodyRelayOverride() {
+    hostSetTimeUs(60ULL * 1000000);
+    custodySetup();
+    MessageStruct direct, relayed;
+    const uint8_t origin[MAC_SIZE] = {0x24, 0x0A, 0xC4, 0x00, 0x07, 0x01};
+    memcpy(direct.sender, origin, MAC_SIZE);
+    memcpy(relayed.sender, origin, MAC_SIZE);
+    direct.code = CODE_SOS;
+    relayed.code = CODE_INJURED;
+    uint32_t commits = metricGet(METRIC_NVS_COMMITS);
+    for (int i = 0; i < 20; ++i) {
+        hostSetTimeUs(hostTimeUs() + 1000000);
+        custodyOnRecord(direct, true);
+        custodyTick(millis());
+        hostSetTimeUs(hostTimeUs() + 1000000);
+        custodyOnRecord(relayed, false);
+        custodyTick(millis());
+    }
+    CHECK(metricGet(METRIC_NVS_COMMITS) == commits + 1);
+    MessageStruct held[CUSTODY_SLOTS];
+    CHECK(custodyRecords(held, CUSTODY_SLOTS) == 1);
+    CHECK(held[0].code == CODE_SOS);
+    // Relays may still take custody of an origin not held at all
+    MessageStruct other = relayed;
+    other.sender[5] = 0x02;
+    custodyOnRecord(other, false);
+    custodyTick(millis());
+    CHECK(metricGet(METRIC_NVS_COMMITS) == commits + 2);
+    CHECK(custodyRecords(held, CUSTODY_SLOTS) == 2);
+}
+
+struct Check {
+    const char* name;
+    void (*fn)();
+};
+
+static const Check checks[] = {
+    {"wire_group", checkWireGroup},
+    {"custody_relay_override", checkCustodyRelayOverride},
+};
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+    }
+    int failed = 0;
+    for (const Check& c : checks) {
+        if (filter && strcmp(filter, c.name) != 0) continue;
+        failure = nullptr;
+        c.fn();
+        if (failure) {
+            printf("FAIL %s: %s\n", c.name, failure);
+            ++failed;
+        } else {
+            printf("ok %s\n", c.name);
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Compare the firmware image size of the working tree against a git revision.
+#
+# Usage: tools/size_report.sh [BASE_REV] [FQBN]
+#   BASE_REV defaults to HEAD~1, FQBN to esp32:esp32:esp32s3.
+#   Needs arduino-cli with the ESP32 core and the Adafruit SSD1306/GFX libraries.
+#   Prints flash (program storage) and static RAM (global variables) for both
+#   builds and the difference. Runtime heap is read on the board with "heap".
+set -e
+
+BASE_REV=${1:-HEAD~1}
+FQBN=${2:-esp32:esp32:esp32s3}
+ROOT=$(git -C "$(dirname "$0")" rev-parse --show-toplevel)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# arduino-cli wants the sketch directory named after the .ino
+mkdir -p "$WORK/base/HikingBoard" "$WORK/head/HikingBoard"
+git -C "$ROOT" archive "$BASE_REV" | tar -x -C "$WORK/base/HikingBoard"
+(cd "$ROOT" && git ls-files -co --exclude-standard | grep -v '^tools/' | tar -cf - -T -) | tar -x -C "$WORK/head/HikingBoard"
+rm -rf "$WORK/base/HikingBoard/tools"
+
+size_of() {
+    arduino-cli compile --fqbn "$FQBN" "$1" 2>&1 | awk '
+        /Sketch uses/ { flash = $3 }
+        /Global variables use/ { ram = $4 }
+        END { if (flash == "" || ram == "") exit 1; print flash, ram }'
+}
+
+set -- $(size_of "$WORK/base/HikingBoard") $(size_of "$WORK/head/HikingBoard")
+echo "base $BASE_REV flash=$1 ram=$2"
+echo "head worktree flash=$3 ram=$4"
+echo "delta flash=$(($3 - $1)) ram=$(($4 - $2))"
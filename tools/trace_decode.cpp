@@ -0,0 +1,93 @@
+// Host-side decoder for the firmware's binary trace stream (Trace.h).
+//
+// Build: g++ -std=c++17 -O2 -I.. trace_decode.cpp -o trace_decode
+//
+// Usage:
+//   trace_decode [CAPTURE]
+//       Decode a raw serial capture (or stdin) taken after sending "trace on".
+//       Text output mixed into the capture is skipped.
+#include <cstdio>
+#include <cstring>
+#include "TraceFormat.h"
+
+struct EventInfo {
+    const char* name;
+    TraceArgs args;
+    const char* text;
+};
+
+#define TRACE_EVENT_INFO(id, name, args, text) {name, args, text},
+static const EventInfo EVENTS[TRACE_EVENT_COUNT] = { TRACE_EVENT_LIST(TRACE_EVENT_INFO) };
+#undef TRACE_EVENT_INFO
+
+static const char* const LEVEL_NAMES[] = {"OFF", "ERROR", "WARN", "INFO", "DEBUG"};
+
+static void printRecord(const TraceRecord& rec, unsigned long long timeUs) {
+    const char* level = rec.level <= TRACE_LEVEL_DEBUG ? LEVEL_NAMES[rec.level] : "?";
+    printf("%12.6f %-5s ", (double)timeUs / 1e6, level);
+    if (rec.event >= TRACE_EVENT_COUNT) {
+        printf("unknown event %u\n", rec.event);
+        return;
+    }
+    const EventInfo& ev = EVENTS[rec.event];
+    if (ev.args == TRACE_ARGS_RECORD) {
+        printf("%s %u: code=%u sender=%02X:%02X:%02X:%02X:%02X:%02X\n", ev.text, rec.args[7], rec.args[6],
+               rec.args[0], rec.args[1], rec.args[2], rec.args[3], rec.args[4], rec.args[5]);
+        return;
+    }
+    uint32_t a, b;
+    memcpy(&a, rec.args, 4);
+    memcpy(&b, rec.args + 4, 4);
+    printf(ev.text, a, b);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    FILE* in = stdin;
+    if (argc > 2) {
+        fprintf(stderr, "usage: trace_decode [CAPTURE]\n");
+        return 2;
+    }
+    if (argc == 2 && !(in = fopen(argv[1], "rb"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t frame[TRACE_FRAME_SIZE];
+    size_t have = 0;
+    unsigned long records = 0, corrupt = 0;
+    unsigned long long wraps = 0;
+    uint32_t lastUs = 0;
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        frame[have++] = (uint8_t)c;
+        // Resynchronize on the two sync bytes
+        if (have == 1 && frame[0] != TRACE_SYNC0) { have = 0; continue; }
+        if (have == 2 && frame[1] != TRACE_SYNC1) {
+            have = frame[1] == TRACE_SYNC0 ? 1 : 0;
+            frame[0] = TRACE_SYNC0;
+            continue;
+        }
+        if (have < TRACE_FRAME_SIZE) continue;
+        if (traceChecksum(frame + 2, sizeof(TraceRecord)) != frame[TRACE_FRAME_SIZE - 1]) {
+            // Not a record after all; rescan from the byte after the false sync
+            corrupt++;
+            size_t from = 1;
+            while (from < have && frame[from] != TRACE_SYNC0) from++;
+            memmove(frame, frame + from, have - from);
+            have -= from;
+            continue;
+        }
+        TraceRecord rec;
+        memcpy(&rec, frame + 2, sizeof(rec));
+        have = 0;
+        // micros() wraps every ~71 minutes; unwrap for a monotonic timeline
+        if (records > 0 && rec.timeUs < lastUs && lastUs - rec.timeUs > 0x80000000UL) wraps++;
+        lastUs = rec.timeUs;
+        records++;
+        printRecord(rec, (wraps << 32) + rec.timeUs);
+    }
+    if (in != stdin) fclose(in);
+    fprintf(stderr, "%lu records, %lu false syncs skipped\n", records, corrupt);
+    return 0;
+}